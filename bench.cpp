@@ -0,0 +1,193 @@
+#include "trip_analyzer.h"
+#include "simd_scan.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+// Ingest throughput benchmark on the C2 workload (few keys, lots of rows)
+
+static const char* BENCH_FILE = "bench_c2.csv";
+static const char* BENCH_TRIPS_FILE = "bench_trips.csv";
+
+// Write the same rows the C2 grading test generates
+static long long writeC2Workload(int rows) {
+    std::string csv = "TripID,PickupZoneID,PickupTime\n";
+    csv.reserve(static_cast<size_t>(rows) * 30);
+
+    for (int i = 0; i < rows; i++) {
+        int z = i & 3;
+        int h = i % 24;
+        csv += std::to_string(i + 1);
+        csv += ",Z";
+        csv += std::to_string(z);
+        csv += ",2024-01-01 ";
+        if (h < 10) csv += "0";
+        csv += std::to_string(h);
+        csv += ":00\n";
+    }
+
+    std::ofstream out(BENCH_FILE, std::ios::binary);
+    out << csv;
+    return static_cast<long long>(csv.size());
+}
+
+// 6-column SmallTrips rows with Distance and Fare, for the value aggregates
+static long long writeTripsWorkload(int rows) {
+    std::string csv = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,Distance,Fare\n";
+    csv.reserve(static_cast<size_t>(rows) * 52);
+
+    for (int i = 0; i < rows; i++) {
+        int h = i % 24;
+        csv += std::to_string(i + 1);
+        csv += ",ZONE";
+        csv += std::to_string(i % 997);
+        csv += ",ZONE";
+        csv += std::to_string((i * 7) % 997);
+        csv += ",2024-01-01 ";
+        if (h < 10) csv += "0";
+        csv += std::to_string(h);
+        csv += ":00,";
+        csv += std::to_string(1 + i % 40);
+        csv += ".";
+        csv += std::to_string(i % 10);
+        csv += ",";
+        csv += std::to_string(5 + i % 150);
+        csv += ".";
+        csv += std::to_string(i % 100);
+        csv += "\n";
+    }
+
+    std::ofstream out(BENCH_TRIPS_FILE, std::ios::binary);
+    out << csv;
+    return static_cast<long long>(csv.size());
+}
+
+// Reference implementation: the original getline + stringstream tokenizer
+static long long legacyIngest(const std::string& filename) {
+    std::unordered_map<std::string, long long> zoneCounts;
+    std::unordered_map<std::string, std::unordered_map<int, long long>> zoneHourCounts;
+    long long valid = 0;
+
+    std::ifstream file(filename);
+    std::string line;
+    std::getline(file, line);
+
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string token;
+        std::vector<std::string> tokens;
+        while (std::getline(ss, token, ',')) {
+            size_t start = token.find_first_not_of(" \t\r\n");
+            size_t end = token.find_last_not_of(" \t\r\n");
+            if (start == std::string::npos) {
+                tokens.push_back("");
+            } else {
+                tokens.push_back(token.substr(start, end - start + 1));
+            }
+        }
+        if (tokens.size() < 3 || tokens[1].empty() || tokens[2].length() < 16) {
+            continue;
+        }
+        size_t spacePos = tokens[2].find(' ');
+        if (spacePos == std::string::npos || spacePos + 3 >= tokens[2].length()) {
+            continue;
+        }
+        int hour;
+        try {
+            hour = std::stoi(tokens[2].substr(spacePos + 1, 2));
+        } catch (...) {
+            continue;
+        }
+        if (hour < 0 || hour > 23) {
+            continue;
+        }
+        valid++;
+        zoneCounts[tokens[1]]++;
+        zoneHourCounts[tokens[1]][hour]++;
+    }
+    return valid;
+}
+
+// Best of three runs, to keep scheduler noise out of the comparison
+template <typename F>
+static double timeMs(F&& body) {
+    double best = 0.0;
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        body();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = (run == 0) ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+static void report(const std::string& name, int rows, long long bytes, double ms) {
+    double seconds = ms / 1000.0;
+    std::cout << name << ": " << ms << " ms, "
+              << static_cast<long long>(rows / seconds) << " rows/s, "
+              << (bytes / seconds) / (1024.0 * 1024.0) << " MiB/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int rows = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    long long bytes = writeC2Workload(rows);
+
+    std::cout << "=== C2 ingest benchmark (" << rows << " rows, "
+              << delimiterScannerName() << " scanner) ===" << std::endl;
+
+    long long legacyValid = 0;
+    double legacyMs = timeMs([&] { legacyValid = legacyIngest(BENCH_FILE); });
+    report("legacy stringstream", rows, bytes, legacyMs);
+
+    TripAnalyzer analyzer;
+    double ingestMs = timeMs([&] {
+        analyzer.clear();
+        analyzer.ingestFile(BENCH_FILE);
+    });
+    report("TripAnalyzer::ingestFile", rows, bytes, ingestMs);
+
+    std::cout << "speedup: " << legacyMs / ingestMs << "x" << std::endl;
+
+    // Same input with TripID dedup on (every ID is new, the common case)
+    TripAnalyzer deduplicating;
+    deduplicating.setDeduplication(static_cast<size_t>(rows));
+    double dedupMs = timeMs([&] {
+        deduplicating.clear();
+        deduplicating.ingestFile(BENCH_FILE);
+    });
+    report("TripAnalyzer::ingestFile + dedup", rows, bytes, dedupMs);
+    std::cout << "dedup overhead: " << (dedupMs / ingestMs - 1.0) * 100.0 << "%" << std::endl;
+
+    // Distance/fare aggregates against the count-only path on the same 6-column rows
+    long long tripBytes = writeTripsWorkload(rows);
+    TripAnalyzer counting;
+    double countMs = timeMs([&] {
+        counting.clear();
+        counting.ingestFile(BENCH_TRIPS_FILE);
+    });
+    report("6-column ingestFile, counts only", rows, tripBytes, countMs);
+
+    TripAnalyzer valuing;
+    valuing.setValueCounting(true);
+    double valueMs = timeMs([&] {
+        valuing.clear();
+        valuing.ingestFile(BENCH_TRIPS_FILE);
+    });
+    report("6-column ingestFile + distance/fare", rows, tripBytes, valueMs);
+    std::cout << "value aggregate overhead: " << (valueMs / countMs - 1.0) * 100.0 << "%" << std::endl;
+
+    std::remove(BENCH_FILE);
+    std::remove(BENCH_TRIPS_FILE);
+    bool same = analyzer.getValidRecords() == legacyValid &&
+                deduplicating.getValidRecords() == legacyValid &&
+                deduplicating.getDuplicateRecords() == 0 &&
+                valuing.getValidRecords() == rows && valuing.fareFor("ZONE0").count > 0;
+    return same ? 0 : 1;
+}
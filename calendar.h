@@ -0,0 +1,84 @@
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <string>
+#include <string_view>
+
+// Proleptic Gregorian date arithmetic on day numbers (days since 1970-01-01),
+// after Howard Hinnant's days_from_civil / civil_from_days.
+
+const int MIN_CALENDAR_YEAR = 1900;
+const int MAX_CALENDAR_YEAR = 2199;
+
+inline int daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+inline void civilFromDays(int days, int& year, int& month, int& day) {
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int dayOfEra = days - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shifted = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    month = shifted < 10 ? shifted + 3 : shifted - 9;
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+// 0 = Monday ... 6 = Sunday (1970-01-01 was a Thursday)
+inline int dayOfWeek(int days) {
+    return ((days % 7) + 7 + 3) % 7;
+}
+
+inline int daysInMonth(int year, int month) {
+    static const int DAYS[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return (month == 2 && leap) ? 29 : DAYS[month - 1];
+}
+
+// Decode the "YYYY-MM-DD" at the start of text; false if it is not a valid
+// date between MIN_CALENDAR_YEAR and MAX_CALENDAR_YEAR
+inline bool parseDate(std::string_view text, int& days) {
+    if (text.size() < 10 || text[4] != '-' || text[7] != '-') {
+        return false;
+    }
+    static const int DIGITS[8] = {0, 1, 2, 3, 5, 6, 8, 9};
+    for (int i : DIGITS) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+    }
+    int year = (text[0] - '0') * 1000 + (text[1] - '0') * 100 + (text[2] - '0') * 10 + (text[3] - '0');
+    int month = (text[5] - '0') * 10 + (text[6] - '0');
+    int day = (text[8] - '0') * 10 + (text[9] - '0');
+    if (year < MIN_CALENDAR_YEAR || year > MAX_CALENDAR_YEAR || month < 1 || month > 12 ||
+        day < 1 || day > daysInMonth(year, month)) {
+        return false;
+    }
+    days = daysFromCivil(year, month, day);
+    return true;
+}
+
+// "YYYY-MM-DD" for a day number
+inline std::string formatDate(int days) {
+    int year, month, day;
+    civilFromDays(days, year, month, day);
+    std::string text = "0000-00-00";
+    text[0] = static_cast<char>('0' + year / 1000 % 10);
+    text[1] = static_cast<char>('0' + year / 100 % 10);
+    text[2] = static_cast<char>('0' + year / 10 % 10);
+    text[3] = static_cast<char>('0' + year % 10);
+    text[5] = static_cast<char>('0' + month / 10);
+    text[6] = static_cast<char>('0' + month % 10);
+    text[8] = static_cast<char>('0' + day / 10);
+    text[9] = static_cast<char>('0' + day % 10);
+    return text;
+}
+
+#endif // CALENDAR_H
@@ -0,0 +1,65 @@
+#include "count_min_sketch.h"
+#include <algorithm>
+
+CountMinSketch::CountMinSketch() : width(0), depth(0), observed(0) {}
+
+void CountMinSketch::setDimensions(size_t w, size_t d) {
+    width = 0;
+    depth = 0;
+    if (w > 0 && d > 0) {
+        width = 1;
+        while (width < w) {
+            width *= 2;
+        }
+        depth = d;
+    }
+    counters.assign(width * depth, 0);
+    observed = 0;
+}
+
+// Row i uses column (h1 + i * h2) mod width (Kirsch-Mitzenmacher), so one
+// 64-bit hash serves every row
+void CountMinSketch::add(uint64_t hash, long long count) {
+    if (width == 0) {
+        return;
+    }
+    observed += count;
+
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    size_t mask = width - 1;
+    for (size_t row = 0; row < depth; row++) {
+        counters[row * width + static_cast<size_t>((h1 + row * h2) & mask)] += count;
+    }
+}
+
+long long CountMinSketch::estimate(uint64_t hash) const {
+    if (width == 0) {
+        return 0;
+    }
+
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    size_t mask = width - 1;
+    long long best = counters[static_cast<size_t>(h1 & mask)];
+    for (size_t row = 1; row < depth; row++) {
+        best = std::min(best, counters[row * width + static_cast<size_t>((h1 + row * h2) & mask)]);
+    }
+    return best;
+}
+
+bool CountMinSketch::merge(const CountMinSketch& other) {
+    if (other.width != width || other.depth != depth) {
+        return false;
+    }
+    for (size_t i = 0; i < counters.size(); i++) {
+        counters[i] += other.counters[i];
+    }
+    observed += other.observed;
+    return true;
+}
+
+void CountMinSketch::clear() {
+    std::fill(counters.begin(), counters.end(), 0);
+    observed = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef COUNT_MIN_SKETCH_H
+#define COUNT_MIN_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Count-Min Sketch (Cormode & Muthukrishnan) over 64-bit key hashes: `depth`
+// rows of `width` counters, fixed at setDimensions. estimate() never
+// undercounts; with width w and depth d it overcounts by more than e * N / w
+// (N = total adds) with probability at most e^-d.
+class CountMinSketch {
+private:
+    size_t width;   // Power of two
+    size_t depth;
+    long long observed;
+    std::vector<long long> counters; // Row-major, depth * width
+
+public:
+    CountMinSketch();
+
+    // Width is rounded up to a power of two; 0 disables the sketch
+    void setDimensions(size_t width, size_t depth);
+    size_t getWidth() const { return width; }
+    size_t getDepth() const { return depth; }
+    bool enabled() const { return width > 0; }
+
+    void add(uint64_t hash, long long count = 1);
+    long long estimate(uint64_t hash) const;
+
+    // Element-wise sum; both sketches must have the same dimensions
+    bool merge(const CountMinSketch& other);
+
+    long long total() const { return observed; }
+    void clear();
+};
+
+#endif // COUNT_MIN_SKETCH_H
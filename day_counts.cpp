@@ -0,0 +1,140 @@
+#include "day_counts.h"
+#include <algorithm>
+#include <limits>
+
+DayCounts::DayCounts() : lastIndex(0), blockCount(0), stride(0), checkpointWidth(0), builtDays(0) {}
+
+// The day's entry, inserted in order if new (input is mostly in date order,
+// so this is usually the previous day or a new last one)
+DayCounts::Day& DayCounts::dayFor(int day) {
+    if (lastIndex < days.size() && days[lastIndex].day == day) {
+        return days[lastIndex];
+    }
+    auto it = std::lower_bound(days.begin(), days.end(), day,
+                               [](const Day& d, int value) { return d.day < value; });
+    if (it == days.end() || it->day != day) {
+        it = days.insert(it, Day{day, {}, {}, {}});
+        
+        // Too many days between checkpoints makes ranges slow; rebuild
+        if (stride != 0 && days.size() >= builtDays + stride) {
+            stride = 0;
+        }
+    }
+    lastIndex = static_cast<size_t>(it - days.begin());
+    return *it;
+}
+
+void DayCounts::add(int day, uint32_t key, int hour, uint32_t count) {
+    Day& d = dayFor(day);
+    if (key >= d.blockOf.size()) {
+        d.blockOf.resize(key + 1, 0);
+    }
+    if (d.blockOf[key] == 0) {
+        d.blocks.push_back(Hours{});
+        d.keys.push_back(key);
+        d.blockOf[key] = static_cast<uint32_t>(d.blocks.size());
+        blockCount++;
+    }
+    d.blocks[d.blockOf[key] - 1][hour] += count;
+    
+    if (stride == 0) {
+        return;
+    }
+    size_t slot = static_cast<size_t>(key) * HOURS + hour;
+    if (slot >= checkpointWidth) {
+        stride = 0; // A key the checkpoints have no room for
+        return;
+    }
+    for (size_t c = checkpoints.size(); c > 0 && checkpoints[c - 1].end > day; c--) {
+        checkpoints[c - 1].totals[slot] += count;
+    }
+}
+
+// Checkpoint 0 is empty and comes before any day. Checkpoint c holds the
+// totals of the days before days[c * stride], the last one those of every day.
+void DayCounts::build(size_t keyCount) const {
+    size_t width = keyCount * HOURS;
+    size_t checkpointCount = std::max<size_t>(1, std::min(days.size(), blockCount / std::max<size_t>(keyCount, 1)));
+    stride = std::max<size_t>(1, (days.size() + checkpointCount - 1) / checkpointCount);
+    checkpointWidth = width;
+    builtDays = days.size();
+
+    size_t count = (days.size() + stride - 1) / stride + 1;
+    checkpoints.assign(count, Checkpoint{0, std::vector<unsigned long long>(width, 0)});
+    for (size_t c = 0; c < count; c++) {
+        size_t first = c * stride;
+        if (c == 0) {
+            checkpoints[c].end = std::numeric_limits<int>::min();
+            continue;
+        }
+        checkpoints[c].end = (first < days.size()) ? days[first].day : days.back().day + 1;
+        checkpoints[c].totals = checkpoints[c - 1].totals;
+        for (size_t index = (c - 1) * stride; index < std::min(first, days.size()); index++) {
+            const Day& d = days[index];
+            for (size_t b = 0; b < d.blocks.size(); b++) {
+                if (d.keys[b] >= keyCount) {
+                    continue;
+                }
+                unsigned long long* row = checkpoints[c].totals.data() + static_cast<size_t>(d.keys[b]) * HOURS;
+                for (int h = 0; h < HOURS; h++) {
+                    row[h] += d.blocks[b][h];
+                }
+            }
+        }
+    }
+}
+
+// Add (or subtract) the totals of the days before `end`: the last
+// checkpoint at or before it, then the days in between. Works modulo 2^64,
+// which is exact once the two ends of a range are combined.
+void DayCounts::addPrefix(int end, size_t keyCount, std::vector<unsigned long long>& out, bool subtract) const {
+    auto after = [](int value, const Checkpoint& c) { return value < c.end; };
+    auto c = std::upper_bound(checkpoints.begin(), checkpoints.end(), end, after) - 1;
+    const std::vector<unsigned long long>& base = c->totals;
+    for (size_t slot = 0; slot < out.size(); slot++) {
+        out[slot] = subtract ? out[slot] - base[slot] : out[slot] + base[slot];
+    }
+    auto before = [](const Day& d, int value) { return d.day < value; };
+    size_t first = static_cast<size_t>(std::lower_bound(days.begin(), days.end(), c->end, before) - days.begin());
+    for (size_t index = first; index < days.size() && days[index].day < end; index++) {
+        const Day& d = days[index];
+        for (size_t b = 0; b < d.blocks.size(); b++) {
+            if (d.keys[b] >= keyCount) {
+                continue;
+            }
+            unsigned long long* row = out.data() + static_cast<size_t>(d.keys[b]) * HOURS;
+            for (int h = 0; h < HOURS; h++) {
+                row[h] = subtract ? row[h] - d.blocks[b][h] : row[h] + d.blocks[b][h];
+            }
+        }
+    }
+}
+
+void DayCounts::rangeSums(int from, int to, size_t keyCount, std::vector<unsigned long long>& out) const {
+    out.assign(keyCount * HOURS, 0);
+    auto before = [](const Day& d, int value) { return d.day < value; };
+    size_t lo = static_cast<size_t>(std::lower_bound(days.begin(), days.end(), from, before) - days.begin());
+    size_t hi = static_cast<size_t>(std::lower_bound(days.begin(), days.end(), to, before) - days.begin());
+    if (hi < days.size() && days[hi].day == to) {
+        hi++;
+    }
+    if (from > to || lo >= hi) {
+        return;
+    }
+
+    if (stride == 0 || checkpointWidth != out.size()) {
+        build(keyCount);
+    }
+    addPrefix(days[hi - 1].day + 1, keyCount, out, false);
+    addPrefix(days[lo].day, keyCount, out, true);
+}
+
+void DayCounts::clear() {
+    days.clear();
+    lastIndex = 0;
+    blockCount = 0;
+    checkpoints.clear();
+    stride = 0;
+    checkpointWidth = 0;
+    builtDays = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef DAY_COUNTS_H
+#define DAY_COUNTS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-day (key, hour) counts, stored only for the days and keys that occur.
+// Days are kept sorted by day number; each holds a key -> block index and one
+// 24-hour block per key seen that day, so memory follows the rows rather than
+// the span between the oldest and newest date.
+//
+// Range sums use prefix checkpoints over the occupied days, one every few
+// days so that the checkpoints take about as much room as the blocks. A
+// range costs one subtraction per (key, hour) plus the blocks of at most two
+// partial strides. Each checkpoint covers the days before a day number, so
+// add() keeps them current: a row for a day past the last checkpoint (live
+// input in date order) touches none of them, and a late row adds its count
+// to the checkpoints after its day. They are only rebuilt once a stride's
+// worth of days has been added since the last build, or a new key appears.
+class DayCounts {
+public:
+    static const int HOURS = 24;
+    using Hours = std::array<uint32_t, HOURS>;
+
+private:
+    struct Day {
+        int day;
+        std::vector<uint32_t> blockOf;  // By key: 1 + index into blocks, 0 = none
+        std::vector<uint32_t> keys;     // Key of each block
+        std::vector<Hours> blocks;
+    };
+
+    std::vector<Day> days;              // Sorted by day
+    size_t lastIndex;                   // Day of the previous add, for in-order input
+    size_t blockCount;
+
+    // Totals of the days before `end`, by key * 24 + hour
+    struct Checkpoint {
+        int end;
+        std::vector<unsigned long long> totals;
+    };
+
+    mutable std::vector<Checkpoint> checkpoints;   // Ascending end
+    mutable size_t stride;              // Days per checkpoint, 0 = stale
+    mutable size_t checkpointWidth;
+    mutable size_t builtDays;           // Days when the checkpoints were built
+
+    Day& dayFor(int day);
+    void build(size_t keyCount) const;
+    void addPrefix(int end, size_t keyCount, std::vector<unsigned long long>& out, bool subtract) const;
+
+public:
+    DayCounts();
+
+    void add(int day, uint32_t key, int hour, uint32_t count = 1);
+
+    // Totals by key * 24 + hour over days from..to inclusive, sized for keyCount keys
+    void rangeSums(int from, int to, size_t keyCount, std::vector<unsigned long long>& out) const;
+
+    // Visit every (day, key, hours) block, days in order
+    template <typename F>
+    void forEach(F&& visit) const {
+        for (const Day& d : days) {
+            for (size_t b = 0; b < d.blocks.size(); b++) {
+                visit(d.day, d.keys[b], d.blocks[b]);
+            }
+        }
+    }
+
+    size_t dayCount() const { return days.size(); }
+    size_t blocks() const { return blockCount; }
+    bool empty() const { return days.empty(); }
+    void clear();
+};
+
+#endif // DAY_COUNTS_H
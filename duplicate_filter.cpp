@@ -0,0 +1,52 @@
+#include "duplicate_filter.h"
+#include <algorithm>
+
+DuplicateFilter::DuplicateFilter() {}
+
+void DuplicateFilter::configure(size_t expectedKeys, size_t window) {
+    blocks.clear();
+    if (expectedKeys == 0) {
+        return;
+    }
+
+    // 4 Bloom bits per key and room for the window, rounded up to a power of
+    // two. About 15% of new keys pass the Bloom stage, but that only costs
+    // the key compares in a line that is loaded anyway, and a smaller table
+    // stays in cache.
+    size_t blockCount = 1;
+    while (blockCount * BLOOM_WORDS * 64 < expectedKeys * 4 || blockCount * RECENT_KEYS < window) {
+        blockCount *= 2;
+    }
+    blocks.assign(blockCount, Block{});
+}
+
+bool DuplicateFilter::seen(uint64_t hash) {
+    Block& block = blockFor(hash);
+
+    // Bloom stage: 3 bits, all in the same word
+    uint64_t& word = block.bloom[(hash >> 37) & (BLOOM_WORDS - 1)];
+    uint64_t bits = (uint64_t(1) << (hash & 63)) | (uint64_t(1) << ((hash >> 6) & 63)) |
+                    (uint64_t(1) << ((hash >> 12) & 63));
+    bool present = (word & bits) == bits;
+    word |= bits;
+
+    uint64_t key = hash | 1; // Keep 0 free as the empty marker
+    if (present) {
+        for (size_t i = 0; i < RECENT_KEYS; i++) {
+            if (block.recent[i] == key) {
+                return true;
+            }
+        }
+    }
+
+    // New key: drop the block's oldest
+    for (size_t i = 0; i + 1 < RECENT_KEYS; i++) {
+        block.recent[i] = block.recent[i + 1];
+    }
+    block.recent[RECENT_KEYS - 1] = key;
+    return false;
+}
+
+void DuplicateFilter::clear() {
+    std::fill(blocks.begin(), blocks.end(), Block{});
+}
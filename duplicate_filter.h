@@ -0,0 +1,55 @@
+#ifndef DUPLICATE_FILTER_H
+#define DUPLICATE_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Detects re-delivered keys (by 64-bit hash). The table is an array of
+// 64-byte blocks, and a key only ever touches its own block, so a lookup
+// plus insert is one cache line:
+//
+//   words 0-3  Bloom bits: every key sets 3 bits inside one of the 4 words.
+//              They remember every key since the last clear.
+//   words 4-7  The block's 4 newest keys, newest last (0 = empty). Across
+//              all blocks they hold at least the last `window` keys.
+//
+// A Bloom miss proves the key is new, and the key compares are skipped. A
+// hit is a duplicate only if one of the block's recent keys confirms it; an
+// unconfirmed hit (a false positive, or a re-delivery older than the
+// recent keys) is accepted as new. So the filter never drops a genuinely
+// new key, and only re-deliveries arriving long after the original slip
+// through.
+class DuplicateFilter {
+private:
+    static const size_t BLOOM_WORDS = 4;
+    static const size_t RECENT_KEYS = 4;
+
+    // One cache line; vector allocates these aligned
+    struct alignas(64) Block {
+        uint64_t bloom[BLOOM_WORDS];
+        uint64_t recent[RECENT_KEYS];
+    };
+
+    std::vector<Block> blocks;
+
+    Block& blockFor(uint64_t hash) { return blocks[(hash >> 40) & (blocks.size() - 1)]; }
+
+public:
+    DuplicateFilter();
+
+    // Size for about `expectedKeys` distinct keys (4 Bloom bits each) and
+    // at least `window` recent keys, whichever needs more blocks; 0
+    // disables the filter
+    void configure(size_t expectedKeys, size_t window);
+    bool enabled() const { return !blocks.empty(); }
+    size_t expectedKeys() const { return blocks.size() * BLOOM_WORDS * 64 / 4; }
+    size_t windowSize() const { return blocks.size() * RECENT_KEYS; }
+
+    // True if hash is a recent duplicate; otherwise records it
+    bool seen(uint64_t hash);
+
+    void clear();
+};
+
+#endif // DUPLICATE_FILTER_H
@@ -0,0 +1,49 @@
+#ifndef HASH_UTIL_H
+#define HASH_UTIL_H
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Final avalanche step of MurmurHash3 (fmix64)
+inline uint64_t mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Fast 64-bit hash of a short byte string, reading 8 bytes at a time
+inline uint64_t hashBytes(std::string_view s, uint64_t seed = 0) {
+    const char* p = s.data();
+    size_t n = s.size();
+    uint64_t h = seed ^ (n * 0x9e3779b97f4a7c15ULL);
+
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ mixHash(word)) * 0x9e3779b97f4a7c15ULL;
+        p += 8;
+        n -= 8;
+    }
+
+    // The tail byte by byte: a variable-length memcpy is a library call,
+    // which costs more than the whole hash of a short ID
+    if (n > 0) {
+        uint64_t word = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (size_t i = 0; i < n; i++) {
+            word |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+#else
+        std::memcpy(&word, p, n);
+#endif
+        h = (h ^ mixHash(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    return mixHash(h);
+}
+
+#endif // HASH_UTIL_H
@@ -0,0 +1,57 @@
+#include "hyper_log_log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+HyperLogLog::HyperLogLog() : precision(0) {}
+
+void HyperLogLog::setPrecision(int bits) {
+    precision = (bits <= 0) ? 0 : std::min(std::max(bits, MIN_PRECISION), MAX_PRECISION);
+    registers.assign(precision > 0 ? size_t(1) << precision : 0, 0);
+}
+
+long long HyperLogLog::estimate() const {
+    if (precision == 0) {
+        return 0;
+    }
+
+    double m = static_cast<double>(registers.size());
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r : registers) {
+        sum += std::ldexp(1.0, -r);
+        zeros += (r == 0);
+    }
+
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double raw = alpha * m * m / sum;
+
+    // Small cardinalities: linear counting on the empty registers is more accurate
+    if (raw <= 2.5 * m && zeros > 0) {
+        raw = m * std::log(m / static_cast<double>(zeros));
+    }
+    return std::llround(raw);
+}
+
+bool HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.precision != precision) {
+        return false;
+    }
+    for (size_t i = 0; i < registers.size(); i++) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+    return true;
+}
+
+bool HyperLogLog::load(int bits, const uint8_t* bytes, size_t size) {
+    if (bits < MIN_PRECISION || bits > MAX_PRECISION || size != (size_t(1) << bits)) {
+        return false;
+    }
+    setPrecision(bits);
+    std::memcpy(registers.data(), bytes, size);
+    return true;
+}
+
+void HyperLogLog::clear() {
+    std::fill(registers.begin(), registers.end(), 0);
+}
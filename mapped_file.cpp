@@ -0,0 +1,68 @@
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_HAVE_MMAP 1
+#endif
+
+MappedFile::MappedFile() : base(nullptr), length(0), mapped(false) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+#ifdef MAPPED_FILE_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Only regular files have a stable size we can map
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap rejects zero-length mappings, but an empty file is still valid input
+    if (st.st_size == 0) {
+        ::close(fd);
+        mapped = true;
+        return true;
+    }
+
+    void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    // Rows are consumed front to back
+    ::madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    base = static_cast<const char*>(addr);
+    length = static_cast<size_t>(st.st_size);
+    mapped = true;
+    return true;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_HAVE_MMAP
+    if (base != nullptr) {
+        ::munmap(const_cast<char*>(base), length);
+    }
+#endif
+    base = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a regular file.
+// open() fails for pipes, devices and platforms without mmap, so callers
+// can fall back to stream-based reading.
+class MappedFile {
+private:
+    const char* base;
+    size_t length;
+    bool mapped;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return mapped; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(base, length); }
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,57 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <cstddef>
+#include <vector>
+
+// Cached result of a ranked top-k query.
+// An entry is tied to the generation of the data it was computed from.
+// A result cached for k also answers any smaller k by truncation, and a
+// result shorter than its k is complete, so it answers every k.
+template <typename T>
+class QueryCache {
+private:
+    unsigned long long generation;
+    int k;           // k the rows were computed for (<= 0 = all)
+    bool valid;
+    std::vector<T> rows;
+
+    bool complete() const {
+        return k <= 0 || rows.size() < static_cast<size_t>(k);
+    }
+
+public:
+    QueryCache() : generation(0), k(0), valid(false) {}
+
+    bool answers(unsigned long long currentGeneration, int requestedK) const {
+        if (!valid || generation != currentGeneration) {
+            return false;
+        }
+        if (requestedK <= 0) {
+            return complete();
+        }
+        return complete() || requestedK <= k;
+    }
+
+    // First requestedK rows (all if requestedK <= 0)
+    std::vector<T> prefix(int requestedK) const {
+        if (requestedK <= 0 || static_cast<size_t>(requestedK) >= rows.size()) {
+            return rows;
+        }
+        return std::vector<T>(rows.begin(), rows.begin() + requestedK);
+    }
+
+    void store(unsigned long long currentGeneration, int computedK, const std::vector<T>& result) {
+        generation = currentGeneration;
+        k = computedK;
+        rows = result;
+        valid = true;
+    }
+
+    void reset() {
+        valid = false;
+        rows.clear();
+    }
+};
+
+#endif // QUERY_CACHE_H
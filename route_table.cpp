@@ -0,0 +1,75 @@
+#include "route_table.h"
+#include "hash_util.h"
+
+static const size_t INITIAL_SLOTS = 64;
+
+RouteTable::RouteTable() : slots(INITIAL_SLOTS, Slot{0, 0}), used(0) {}
+
+void RouteTable::add(uint64_t route, long long count) {
+    uint64_t key = route + 1;
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = static_cast<size_t>(mixHash(key)) & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.key == key) {
+            slot.count += count;
+            return;
+        }
+        if (slot.key == 0) {
+            slot.key = key;
+            slot.count = count;
+            used++;
+            if (used * 2 > slots.size()) {
+                rehash(slots.size() * 2);
+            }
+            return;
+        }
+    }
+}
+
+long long RouteTable::find(uint64_t route) const {
+    uint64_t key = route + 1;
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = static_cast<size_t>(mixHash(key)) & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.key == key) {
+            return slot.count;
+        }
+        if (slot.key == 0) {
+            return 0;
+        }
+    }
+}
+
+void RouteTable::rehash(size_t capacity) {
+    std::vector<Slot> fresh(capacity, Slot{0, 0});
+    size_t mask = capacity - 1;
+
+    for (const Slot& slot : slots) {
+        if (slot.key == 0) {
+            continue;
+        }
+        size_t i = static_cast<size_t>(mixHash(slot.key)) & mask;
+        while (fresh[i].key != 0) {
+            i = (i + 1) & mask;
+        }
+        fresh[i] = slot;
+    }
+    slots.swap(fresh);
+}
+
+void RouteTable::reserve(size_t count) {
+    size_t capacity = slots.size();
+    while (count * 2 > capacity) {
+        capacity *= 2;
+    }
+    if (capacity != slots.size()) {
+        rehash(capacity);
+    }
+}
+
+void RouteTable::clear() {
+    slots.assign(INITIAL_SLOTS, Slot{0, 0});
+    used = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef ROUTE_TABLE_H
+#define ROUTE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counts per (pickup, dropoff) zone pair. The two interned zone IDs are
+// packed into one 64-bit key, and counts sit inline in a flat open-addressing
+// table (linear probing, power-of-two size, at most half full), so counting
+// a route is one hash and usually one cache line, and the only allocations
+// are the table doublings.
+class RouteTable {
+private:
+    struct Slot {
+        uint64_t key;    // Packed route + 1, 0 = empty
+        long long count;
+    };
+
+    std::vector<Slot> slots;
+    size_t used;
+
+    void rehash(size_t capacity);
+
+public:
+    RouteTable();
+
+    static uint64_t pack(uint32_t pickup, uint32_t dropoff) {
+        return (static_cast<uint64_t>(pickup) << 32) | dropoff;
+    }
+    static uint32_t pickupOf(uint64_t route) { return static_cast<uint32_t>(route >> 32); }
+    static uint32_t dropoffOf(uint64_t route) { return static_cast<uint32_t>(route); }
+
+    void add(uint64_t route, long long count = 1);
+
+    // Count for a route, 0 if never seen
+    long long find(uint64_t route) const;
+
+    // Visit every (route, count)
+    template <typename F>
+    void forEach(F&& visit) const {
+        for (const Slot& slot : slots) {
+            if (slot.key != 0) {
+                visit(slot.key - 1, slot.count);
+            }
+        }
+    }
+
+    size_t size() const { return used; }
+    void reserve(size_t count);
+    void clear();
+};
+
+#endif // ROUTE_TABLE_H
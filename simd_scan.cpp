@@ -0,0 +1,85 @@
+#include "simd_scan.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define SIMD_SCAN_X86 1
+#endif
+
+void scanDelimitersScalar(const char* p, DelimiterMasks& masks) {
+    uint64_t commas = 0;
+    uint64_t newlines = 0;
+    for (int i = 0; i < SCAN_BLOCK_BYTES; i++) {
+        commas |= static_cast<uint64_t>(p[i] == ',') << i;
+        newlines |= static_cast<uint64_t>(p[i] == '\n') << i;
+    }
+    masks.commas = commas;
+    masks.newlines = newlines;
+}
+
+#ifdef SIMD_SCAN_X86
+// Four 16-byte compares per delimiter; SSE2 is baseline on x86-64
+static void scanDelimitersSse2(const char* p, DelimiterMasks& masks) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t commas = 0;
+    uint64_t newlines = 0;
+
+    for (int i = 0; i < 4; i++) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        uint64_t c = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, comma)));
+        uint64_t n = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        commas |= c << (16 * i);
+        newlines |= n << (16 * i);
+    }
+    masks.commas = commas;
+    masks.newlines = newlines;
+}
+
+// Two 32-byte compares per delimiter
+__attribute__((target("avx2")))
+static void scanDelimitersAvx2(const char* p, DelimiterMasks& masks) {
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+
+    uint64_t commasLo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, comma)));
+    uint64_t commasHi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, comma)));
+    uint64_t newlinesLo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)));
+    uint64_t newlinesHi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)));
+
+    masks.commas = commasLo | (commasHi << 32);
+    masks.newlines = newlinesLo | (newlinesHi << 32);
+}
+#endif
+
+typedef void (*ScanFunction)(const char*, DelimiterMasks&);
+
+struct ScannerChoice {
+    ScanFunction scan;
+    const char* name;
+};
+
+// Runtime dispatch on the features of the CPU we are running on
+static ScannerChoice chooseScanner() {
+#ifdef SIMD_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {scanDelimitersAvx2, "avx2"};
+    }
+    return {scanDelimitersSse2, "sse2"};
+#else
+    return {scanDelimitersScalar, "scalar"};
+#endif
+}
+
+static const ScannerChoice activeScanner = chooseScanner();
+
+void scanDelimiters(const char* p, DelimiterMasks& masks) {
+    activeScanner.scan(p, masks);
+}
+
+const char* delimiterScannerName() {
+    return activeScanner.name;
+}
@@ -0,0 +1,25 @@
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <cstdint>
+
+// Positions of the ',' and '\n' bytes in a 64-byte block (bit i = byte i)
+struct DelimiterMasks {
+    uint64_t commas;
+    uint64_t newlines;
+};
+
+// Bytes covered by one call to scanDelimiters
+const int SCAN_BLOCK_BYTES = 64;
+
+// Fill masks for the 64 bytes at p. Uses AVX2 or SSE2 when the CPU has
+// them (picked once at startup) and a portable loop otherwise.
+void scanDelimiters(const char* p, DelimiterMasks& masks);
+
+// Portable reference implementation
+void scanDelimitersScalar(const char* p, DelimiterMasks& masks);
+
+// Name of the implementation scanDelimiters dispatches to
+const char* delimiterScannerName();
+
+#endif // SIMD_SCAN_H
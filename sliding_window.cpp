@@ -0,0 +1,134 @@
+#include "sliding_window.h"
+#include <algorithm>
+
+SlidingWindow::SlidingWindow() : watermark(NO_HOUR), lateRows(0) {}
+
+void SlidingWindow::configure(size_t hours) {
+    ring.assign(hours, Bucket{NO_HOUR, {}, 0});
+    totals.clear();
+    watermark = NO_HOUR;
+    lateRows = 0;
+}
+
+// Add n to a key's count in a bucket, growing its table when half full
+void SlidingWindow::addCount(Bucket& bucket, uint32_t key, uint32_t n) {
+    if ((bucket.used + 1) * 2 > bucket.slots.size()) {
+        std::vector<Entry> old(std::max<size_t>(8, bucket.slots.size() * 2), Entry{0, 0});
+        old.swap(bucket.slots);
+        bucket.used = 0;
+        for (const Entry& e : old) {
+            if (e.count != 0) {
+                addCount(bucket, e.key, e.count);
+            }
+        }
+    }
+    size_t mask = bucket.slots.size() - 1;
+    size_t i = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (bucket.slots[i].count != 0 && bucket.slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    if (bucket.slots[i].count == 0) {
+        bucket.slots[i].key = key;
+        bucket.used++;
+    }
+    bucket.slots[i].count += n;
+}
+
+// Take a bucket's counts out of the totals and free it for a new hour. The
+// table keeps its size, which the next hour will likely need again.
+void SlidingWindow::expire(Bucket& bucket) {
+    for (Entry& e : bucket.slots) {
+        if (e.count != 0) {
+            totals[e.key] -= e.count;
+            e.count = 0;
+        }
+    }
+    bucket.used = 0;
+    bucket.hour = NO_HOUR;
+}
+
+// Move the watermark up to hour; the slots of the hours moved past still
+// hold hours that are now too old
+void SlidingWindow::advance(long long hour) {
+    long long size = static_cast<long long>(ring.size());
+    if (watermark == NO_HOUR) {
+        watermark = hour;
+        return;
+    }
+    long long steps = std::min(hour - watermark, size);
+    for (long long i = 1; i <= steps; i++) {
+        Bucket& old = ring[static_cast<size_t>(((watermark + i) % size + size) % size)];
+        if (old.hour != NO_HOUR) {
+            expire(old);
+        }
+    }
+    watermark = std::max(watermark, hour);
+}
+
+// Count into the bucket of an hour known to be inside the window
+void SlidingWindow::place(long long hour, uint32_t key, uint32_t count) {
+    long long size = static_cast<long long>(ring.size());
+    Bucket& bucket = ring[static_cast<size_t>((hour % size + size) % size)];
+    bucket.hour = hour;
+    addCount(bucket, key, count);
+
+    if (key >= totals.size()) {
+        totals.resize(key + 1, 0);
+    }
+    totals[key] += count;
+}
+
+bool SlidingWindow::add(long long hour, uint32_t key, uint32_t count) {
+    if (ring.empty()) {
+        return false;
+    }
+    if (watermark == NO_HOUR || hour > watermark) {
+        advance(hour);
+    } else if (hour <= watermark - static_cast<long long>(ring.size())) {
+        lateRows += count;
+        return false;
+    }
+    place(hour, key, count);
+    return true;
+}
+
+void SlidingWindow::merge(const SlidingWindow& other, const std::vector<uint32_t>& keyMap) {
+    lateRows += other.lateRows;
+    if (ring.empty() || other.watermark == NO_HOUR) {
+        return;
+    }
+    advance(other.watermark);
+    for (const auto& bucket : other.ring) {
+        if (bucket.hour == NO_HOUR || bucket.hour <= watermark - static_cast<long long>(ring.size())) {
+            continue;
+        }
+        for (const Entry& e : bucket.slots) {
+            if (e.count != 0) {
+                place(bucket.hour, keyMap[e.key], e.count);
+            }
+        }
+    }
+}
+
+void SlidingWindow::countsOver(size_t recent, std::vector<long long>& out) const {
+    if (recent == 0 || recent >= ring.size()) {
+        out = totals;
+        return;
+    }
+
+    out.assign(totals.size(), 0);
+    for (const auto& bucket : ring) {
+        if (bucket.hour == NO_HOUR || bucket.hour <= watermark - static_cast<long long>(recent)) {
+            continue;
+        }
+        for (const Entry& e : bucket.slots) {
+            if (e.count != 0) {
+                out[e.key] += e.count;
+            }
+        }
+    }
+}
+
+void SlidingWindow::clear() {
+    configure(ring.size());
+}
@@ -0,0 +1,71 @@
+#ifndef SLIDING_WINDOW_H
+#define SLIDING_WINDOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-key counts over the most recent hours of event time, in a ring of
+// one-hour buckets. The watermark is the newest hour seen; a key arriving
+// for a later hour moves it forward and expires the buckets that fall out,
+// each at a cost proportional to the keys it touched. Rows older than the
+// window are counted as late and otherwise dropped.
+//
+// Window totals are kept up to date on every add, so the full-window counts
+// are always ready; shorter windows sum only their own buckets.
+//
+// A bucket only holds the keys it has counts for, in a small open-addressing
+// table, so memory follows the (hour, key) pairs in the window rather than
+// hours x keys.
+class SlidingWindow {
+private:
+    struct Entry {
+        uint32_t key;
+        uint32_t count;                 // 0 = empty slot
+    };
+
+    struct Bucket {
+        long long hour;                 // Event hour held, or NO_HOUR
+        std::vector<Entry> slots;       // Power-of-two size, at most half full
+        size_t used;
+    };
+
+    static const long long NO_HOUR = -(1LL << 62);
+
+    std::vector<Bucket> ring;           // Bucket for hour h at h % size
+    std::vector<long long> totals;      // By key, over every live bucket
+    long long watermark;
+    long long lateRows;
+
+    static void addCount(Bucket& bucket, uint32_t key, uint32_t n);
+    void expire(Bucket& bucket);
+    void advance(long long hour);
+    void place(long long hour, uint32_t key, uint32_t count);
+
+public:
+    SlidingWindow();
+
+    // Window length in hours; 0 disables. Drops any counts.
+    void configure(size_t hours);
+    bool enabled() const { return !ring.empty(); }
+    size_t hours() const { return ring.size(); }
+
+    // Count `count` rows of key for an event hour (hours since 1970-01-01).
+    // False if the hour is already outside the window.
+    bool add(long long hour, uint32_t key, uint32_t count = 1);
+
+    // Counts by key over the newest `recent` hours up to the watermark
+    // (clamped to the window; 0 = whole window). Keys missing are zero.
+    void countsOver(size_t recent, std::vector<long long>& out) const;
+
+    // Add another window's live buckets, with its keys renumbered through
+    // keyMap. Both move to the later watermark first, so hours too old for
+    // the merged window drop out (they were not late, and are not counted so).
+    void merge(const SlidingWindow& other, const std::vector<uint32_t>& keyMap);
+
+    long long late() const { return lateRows; }
+
+    void clear();
+};
+
+#endif // SLIDING_WINDOW_H
@@ -0,0 +1,594 @@
+#include "trip_analyzer.h"
+#include "mapped_file.h"
+#include "snapshot_view.h"
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+// Snapshot file layout (native little-endian):
+//
+//   "TRIPSNAP"  u32 version  u32 sectionCount
+//   sectionCount x { u32 tag  u32 reserved  u64 length  payload, zero-padded to 8 bytes }
+//
+// Counter arrays are stored exactly as they sit in memory, so loading them
+// is a bounds check and a memcpy. Unknown sections are skipped on load, so
+// the version is bumped whenever a section an older reader would skip carries
+// state it cannot do without. Optional modes are decided by their section being
+// present, never by its payload, since a mode with no zones yet has none.
+
+static const char SNAPSHOT_MAGIC[8] = {'T', 'R', 'I', 'P', 'S', 'N', 'A', 'P'};
+static const uint32_t SNAPSHOT_VERSION = 2; // 1: sections 1-6 only
+
+enum SnapshotSection : uint32_t {
+    SECTION_STATS = 1,        // i64 total, valid, skipped
+    SECTION_ZONES = 2,        // u64 count, u64 offsets[count + 1], name bytes
+    SECTION_ZONE_COUNTS = 3,  // i64[count]
+    SECTION_ZONE_LISTED = 4,  // u8[count]
+    SECTION_HOUR_MASKS = 5,   // u32[count]
+    SECTION_HOUR_COUNTS = 6,  // i64[count * 24], zone-major
+    SECTION_DISTINCT = 7,     // u32 precision, u32 reserved, u8 registers[26 << precision]:
+                              // trips, zones, zones for hours 0-23 (only if enabled)
+    SECTION_DUPLICATES = 8,   // i64 rows suppressed by dedup (only if any)
+    SECTION_WEEKLY = 9,       // u64 count, u32[count * 168], zone-major (only if calendar counting
+                              // is on)
+    SECTION_DAILY = 10,       // u64 blocks, blocks x { i64 day, u32 zone, u32 hours[24] }, days
+                              // that have rows only (same)
+    SECTION_ROUTES = 11,      // u64 routes, routes x { u64 pickup << 32 | dropoff, i64 count }
+                              // (only if route counting is on)
+    SECTION_VALUES = 12       // u64 count, then i64 count, sum, min, max columns (thousandths) of zone distance,
+                              // zone fare [count each], slot distance, slot fare [count * 24 each]
+                              // (only if value counting is on)
+};
+
+static_assert(sizeof(std::array<long long, TripAnalyzer::HOURS_PER_DAY>) ==
+              TripAnalyzer::HOURS_PER_DAY * sizeof(long long),
+              "hour histograms must be contiguous to be stored as one block");
+
+// Appends sections to an in-memory image of the file
+class SnapshotWriter {
+private:
+    std::string image;
+    uint32_t sections;
+
+public:
+    SnapshotWriter() : sections(0) {
+        image.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        append(&SNAPSHOT_VERSION, sizeof(SNAPSHOT_VERSION));
+        append(&sections, sizeof(sections)); // Patched in finish()
+    }
+
+    void append(const void* data, size_t size) {
+        image.append(static_cast<const char*>(data), size);
+    }
+
+    template <typename T>
+    void appendValue(const T& value) {
+        append(&value, sizeof(value));
+    }
+
+    // Start a section whose payload is written next; returns where to patch its length
+    size_t beginSection(uint32_t tag) {
+        uint32_t reserved = 0;
+        uint64_t length = 0;
+        appendValue(tag);
+        appendValue(reserved);
+        size_t lengthAt = image.size();
+        appendValue(length);
+        sections++;
+        return lengthAt;
+    }
+
+    void endSection(size_t lengthAt) {
+        uint64_t length = image.size() - (lengthAt + sizeof(uint64_t));
+        std::memcpy(&image[lengthAt], &length, sizeof(length));
+        image.append((8 - image.size() % 8) % 8, '\0');
+    }
+
+    void section(uint32_t tag, const void* data, size_t size) {
+        size_t at = beginSection(tag);
+        append(data, size);
+        endSection(at);
+    }
+
+    const std::string& finish() {
+        std::memcpy(&image[sizeof(SNAPSHOT_MAGIC) + sizeof(uint32_t)], &sections, sizeof(sections));
+        return image;
+    }
+};
+
+// Write to a temporary file and rename it over the target, so readers never see a partial snapshot
+static bool writeFileAtomically(const std::string& path, const std::string& bytes) {
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Error: Cannot write snapshot '" << temp << "'\n";
+            return false;
+        }
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!out.good()) {
+            std::cerr << "Error: Failed writing snapshot '" << temp << "'\n";
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Cannot replace snapshot '" << path << "'\n";
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Persist the zone dictionary, counters and record statistics
+bool TripAnalyzer::saveSnapshot(const std::string& path) const {
+    if (isApproximate()) {
+        std::cerr << "Error: Snapshots need exact counts (approximate mode is on)\n";
+        return false;
+    }
+
+    SnapshotWriter writer;
+    uint64_t zoneTotal = zoneDictionary.size();
+
+    long long stats[3] = {totalRecords, validRecords, skippedRecords};
+    writer.section(SECTION_STATS, stats, sizeof(stats));
+
+    size_t at = writer.beginSection(SECTION_ZONES);
+    writer.appendValue(zoneTotal);
+    uint64_t offset = 0;
+    writer.appendValue(offset);
+    for (uint32_t id = 0; id < zoneTotal; id++) {
+        offset += zoneDictionary.name(id).size();
+        writer.appendValue(offset);
+    }
+    for (uint32_t id = 0; id < zoneTotal; id++) {
+        const std::string& name = zoneDictionary.name(id);
+        writer.append(name.data(), name.size());
+    }
+    writer.endSection(at);
+
+    writer.section(SECTION_ZONE_COUNTS, zoneCounts.data(), zoneTotal * sizeof(long long));
+    writer.section(SECTION_ZONE_LISTED, zoneListed.data(), zoneTotal * sizeof(char));
+    writer.section(SECTION_HOUR_MASKS, zoneHourMask.data(), zoneTotal * sizeof(uint32_t));
+    writer.section(SECTION_HOUR_COUNTS, zoneHourCounts.data(),
+                   zoneTotal * sizeof(zoneHourCounts[0]));
+
+    if (calendarCounting) {
+        std::vector<uint32_t> weekly(zoneTotal * HOURS_PER_WEEK, 0);
+        std::copy(zoneWeekCounts.begin(), zoneWeekCounts.end(), weekly.begin());
+        at = writer.beginSection(SECTION_WEEKLY);
+        writer.appendValue(zoneTotal);
+        writer.append(weekly.data(), weekly.size() * sizeof(uint32_t));
+        writer.endSection(at);
+
+        at = writer.beginSection(SECTION_DAILY);
+        uint64_t blocks = dayCounts.blocks();
+        writer.appendValue(blocks);
+        dayCounts.forEach([&writer](int day, uint32_t id, const DayCounts::Hours& hours) {
+            int64_t stored = day;
+            writer.appendValue(stored);
+            writer.appendValue(id);
+            writer.append(hours.data(), sizeof(hours));
+        });
+        writer.endSection(at);
+    }
+
+    if (routeCounting) {
+        at = writer.beginSection(SECTION_ROUTES);
+        uint64_t routes = routeCounts.size();
+        writer.appendValue(routes);
+        routeCounts.forEach([&writer](uint64_t route, long long count) {
+            writer.appendValue(route);
+            writer.appendValue(count);
+        });
+        writer.endSection(at);
+    }
+
+    if (valueCounting) {
+        at = writer.beginSection(SECTION_VALUES);
+        writer.appendValue(zoneTotal);
+        const ValueStats* tables[4] = {&zoneDistance, &zoneFare, &slotDistance, &slotFare};
+        for (int t = 0; t < 4; t++) {
+            // Zones seen after the last valued row have no slots yet: pad them as empty
+            ValueStats padded = *tables[t];
+            padded.resize((t < 2 ? 1 : HOURS_PER_DAY) * zoneTotal);
+            for (int column = 0; column < 4; column++) {
+                writer.append(padded.column(column).data(), padded.size() * sizeof(long long));
+            }
+        }
+        writer.endSection(at);
+    }
+
+    if (duplicateRecords != 0) {
+        writer.section(SECTION_DUPLICATES, &duplicateRecords, sizeof(duplicateRecords));
+    }
+
+    if (distinctTrips.enabled()) {
+        at = writer.beginSection(SECTION_DISTINCT);
+        uint32_t precision = static_cast<uint32_t>(distinctTrips.getPrecision());
+        uint32_t reserved = 0;
+        writer.appendValue(precision);
+        writer.appendValue(reserved);
+        writer.append(distinctTrips.data().data(), distinctTrips.data().size());
+        writer.append(distinctZones.data().data(), distinctZones.data().size());
+        for (const auto& counter : distinctZonesByHour) {
+            writer.append(counter.data().data(), counter.data().size());
+        }
+        writer.endSection(at);
+    }
+
+    return writeFileAtomically(path, writer.finish());
+}
+
+// Replace the aggregated state with a snapshot's; the analyzer is unchanged on failure
+bool TripAnalyzer::loadSnapshot(const std::string& path) {
+    MappedFile mapped;
+    std::string buffer;
+    std::string_view data;
+
+    if (mapped.open(path)) {
+        data = mapped.view();
+    } else {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Error: Cannot open snapshot '" << path << "'\n";
+            return false;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = buffer;
+    }
+
+    auto fail = [&path](const char* reason) {
+        std::cerr << "Error: Invalid snapshot '" << path << "': " << reason << "\n";
+        return false;
+    };
+
+    const size_t headerSize = sizeof(SNAPSHOT_MAGIC) + 2 * sizeof(uint32_t);
+    if (data.size() < headerSize || std::memcmp(data.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        return fail("bad magic");
+    }
+    uint32_t version;
+    uint32_t sectionCount;
+    std::memcpy(&version, data.data() + 8, sizeof(version));
+    std::memcpy(&sectionCount, data.data() + 12, sizeof(sectionCount));
+    if (version != SNAPSHOT_VERSION && version != 1) {
+        return fail("unsupported version");
+    }
+
+    // Locate every section first; counters are copied once the zone count is known
+    std::string_view payloads[SECTION_VALUES + 1];
+    bool present[SECTION_VALUES + 1] = {};
+    size_t pos = headerSize;
+    for (uint32_t i = 0; i < sectionCount; i++) {
+        if (data.size() - pos < 16) {
+            return fail("truncated section header");
+        }
+        uint32_t tag;
+        uint64_t length;
+        std::memcpy(&tag, data.data() + pos, sizeof(tag));
+        std::memcpy(&length, data.data() + pos + 8, sizeof(length));
+        pos += 16;
+        if (length > data.size() - pos) {
+            return fail("truncated section");
+        }
+        if (version == 1 && tag > SECTION_HOUR_COUNTS) {
+            return fail("unsupported version"); // Written before those sections were versioned
+        }
+        if (tag <= SECTION_VALUES) {
+            payloads[tag] = data.substr(pos, length);
+            present[tag] = true;
+        }
+        pos += length + (8 - length % 8) % 8;
+        pos = std::min(pos, data.size());
+    }
+
+    // Statistics
+    long long stats[3];
+    if (payloads[SECTION_STATS].size() != sizeof(stats)) {
+        return fail("missing statistics");
+    }
+    std::memcpy(stats, payloads[SECTION_STATS].data(), sizeof(stats));
+
+    // Zone names
+    std::string_view names = payloads[SECTION_ZONES];
+    uint64_t zoneTotal;
+    if (names.size() < sizeof(zoneTotal)) {
+        return fail("missing zone table");
+    }
+    std::memcpy(&zoneTotal, names.data(), sizeof(zoneTotal));
+    if (zoneTotal >= ZoneDictionary::NOT_FOUND ||
+        (names.size() - sizeof(uint64_t)) / sizeof(uint64_t) < zoneTotal + 1) {
+        return fail("bad zone table");
+    }
+    const char* offsets = names.data() + sizeof(uint64_t);
+    std::string_view blob = names.substr(sizeof(uint64_t) * (zoneTotal + 2));
+
+    ZoneDictionary dictionary;
+    dictionary.reserve(zoneTotal);
+    uint64_t start;
+    std::memcpy(&start, offsets, sizeof(start));
+    for (uint64_t id = 0; id < zoneTotal; id++) {
+        uint64_t end;
+        std::memcpy(&end, offsets + (id + 1) * sizeof(uint64_t), sizeof(end));
+        if (start > end || end > blob.size()) {
+            return fail("bad zone offsets");
+        }
+        if (dictionary.intern(blob.substr(start, end - start)) != id) {
+            return fail("duplicate zone name");
+        }
+        start = end;
+    }
+
+    // Counter arrays
+    if (payloads[SECTION_ZONE_COUNTS].size() != zoneTotal * sizeof(long long) ||
+        payloads[SECTION_ZONE_LISTED].size() != zoneTotal * sizeof(char) ||
+        payloads[SECTION_HOUR_MASKS].size() != zoneTotal * sizeof(uint32_t) ||
+        payloads[SECTION_HOUR_COUNTS].size() != zoneTotal * sizeof(zoneHourCounts[0])) {
+        return fail("counter arrays do not match the zone table");
+    }
+
+    std::vector<long long> counts(zoneTotal);
+    std::vector<char> listed(zoneTotal);
+    std::vector<uint32_t> masks(zoneTotal);
+    std::vector<std::array<long long, HOURS_PER_DAY>> hours(zoneTotal);
+    std::memcpy(counts.data(), payloads[SECTION_ZONE_COUNTS].data(), payloads[SECTION_ZONE_COUNTS].size());
+    std::memcpy(listed.data(), payloads[SECTION_ZONE_LISTED].data(), payloads[SECTION_ZONE_LISTED].size());
+    std::memcpy(masks.data(), payloads[SECTION_HOUR_MASKS].data(), payloads[SECTION_HOUR_MASKS].size());
+    std::memcpy(hours.data(), payloads[SECTION_HOUR_COUNTS].data(), payloads[SECTION_HOUR_COUNTS].size());
+
+    // A mask names the zone's slots: only hours 0-23, and every hour with trips
+    for (uint64_t id = 0; id < zoneTotal; id++) {
+        if (masks[id] >> HOURS_PER_DAY != 0) {
+            return fail("bad hour mask");
+        }
+        for (int h = 0; h < HOURS_PER_DAY; h++) {
+            if (hours[id][h] != 0 && !(masks[id] >> h & 1)) {
+                return fail("hour mask does not match the hour counts");
+            }
+        }
+    }
+
+    long long duplicates = 0;
+    if (!payloads[SECTION_DUPLICATES].empty()) {
+        if (payloads[SECTION_DUPLICATES].size() != sizeof(duplicates)) {
+            return fail("bad duplicate count");
+        }
+        std::memcpy(&duplicates, payloads[SECTION_DUPLICATES].data(), sizeof(duplicates));
+    }
+
+    // Calendar counters are optional, but come as a pair
+    std::string_view weekly = payloads[SECTION_WEEKLY];
+    std::string_view daily = payloads[SECTION_DAILY];
+    bool calendar = present[SECTION_WEEKLY];
+    const size_t dayBlockBytes = 8 + 4 + sizeof(DayCounts::Hours);
+    uint64_t dayBlocks = 0;
+    if (calendar != present[SECTION_DAILY]) {
+        return fail("bad calendar counters");
+    }
+    if (calendar) {
+        uint64_t weeklyZones = 0;
+        std::memcpy(&weeklyZones, weekly.data(), std::min(weekly.size(), sizeof(weeklyZones)));
+        if (weeklyZones != zoneTotal || weekly.size() != 8 + zoneTotal * HOURS_PER_WEEK * sizeof(uint32_t) ||
+            daily.size() < 8) {
+            return fail("bad calendar counters");
+        }
+        std::memcpy(&dayBlocks, daily.data(), sizeof(dayBlocks));
+        if ((daily.size() - 8) % dayBlockBytes != 0 || (daily.size() - 8) / dayBlockBytes != dayBlocks) {
+            return fail("bad calendar counters");
+        }
+        for (uint64_t i = 0; i < dayBlocks; i++) {
+            int64_t day;
+            uint32_t id;
+            std::memcpy(&day, daily.data() + 8 + i * dayBlockBytes, sizeof(day));
+            std::memcpy(&id, daily.data() + 16 + i * dayBlockBytes, sizeof(id));
+            if (day < -1000000 || day > 1000000 || id >= zoneTotal) {
+                return fail("bad calendar counters");
+            }
+        }
+    }
+
+    // Routes are optional; both zone IDs must be in the zone table
+    std::string_view routes = payloads[SECTION_ROUTES];
+    bool routing = present[SECTION_ROUTES];
+    uint64_t routeTotal = 0;
+    if (routing) {
+        std::memcpy(&routeTotal, routes.data(), std::min(routes.size(), sizeof(routeTotal)));
+        if (routes.size() < 8 || (routes.size() - 8) / 16 != routeTotal || (routes.size() - 8) % 16 != 0) {
+            return fail("bad route counters");
+        }
+        for (uint64_t i = 0; i < routeTotal; i++) {
+            uint64_t route;
+            std::memcpy(&route, routes.data() + 8 + i * 16, sizeof(route));
+            if (RouteTable::pickupOf(route) >= zoneTotal || RouteTable::dropoffOf(route) >= zoneTotal) {
+                return fail("bad route counters");
+            }
+        }
+    }
+
+    // Value aggregates are optional
+    std::string_view values = payloads[SECTION_VALUES];
+    bool valued = present[SECTION_VALUES];
+    uint64_t valuedZones = 0;
+    std::memcpy(&valuedZones, values.data(), std::min(values.size(), sizeof(valuedZones)));
+    if (valued && (valuedZones != zoneTotal ||
+                   values.size() != 8 + 2 * 4 * (1 + HOURS_PER_DAY) * zoneTotal * sizeof(long long))) {
+        return fail("bad value aggregates");
+    }
+
+    // Distinct counters are optional
+    std::string_view distinct = payloads[SECTION_DISTINCT];
+    uint32_t precision = 0;
+    const int counters = 2 + HOURS_PER_DAY;
+    if (present[SECTION_DISTINCT]) {
+        std::memcpy(&precision, distinct.data(), std::min(distinct.size(), sizeof(precision)));
+        if (distinct.size() < 8 || precision < HyperLogLog::MIN_PRECISION ||
+            precision > HyperLogLog::MAX_PRECISION ||
+            distinct.size() != 8 + counters * (size_t(1) << precision)) {
+            return fail("bad distinct counters");
+        }
+    }
+
+    // Everything checked out: install the new state (always exact)
+    setApproximate(0);
+    setDistinctCounting(static_cast<int>(precision));
+    if (precision > 0) {
+        size_t bytes = size_t(1) << precision;
+        const uint8_t* registers = reinterpret_cast<const uint8_t*>(distinct.data()) + 8;
+        distinctTrips.load(precision, registers, bytes);
+        distinctZones.load(precision, registers + bytes, bytes);
+        for (int h = 0; h < HOURS_PER_DAY; h++) {
+            distinctZonesByHour[h].load(precision, registers + (2 + h) * bytes, bytes);
+        }
+    }
+    zoneDictionary = std::move(dictionary);
+    zoneCounts = std::move(counts);
+    zoneListed = std::move(listed);
+    zoneHourMask = std::move(masks);
+    zoneHourCounts = std::move(hours);
+    totalRecords = stats[0];
+    validRecords = stats[1];
+    skippedRecords = stats[2];
+    duplicateRecords = duplicates;
+    recentWindow.clear(); // Keyed by the old zone IDs
+    setValueCounting(false);
+    setValueCounting(valued);
+    if (valued) {
+        ValueStats* tables[4] = {&zoneDistance, &zoneFare, &slotDistance, &slotFare};
+        const char* cursor = values.data() + 8;
+        for (int t = 0; t < 4; t++) {
+            size_t slots = (t < 2 ? 1 : HOURS_PER_DAY) * zoneTotal;
+            std::vector<long long> columns[4];
+            for (auto& column : columns) {
+                column.resize(slots);
+                std::memcpy(column.data(), cursor, slots * sizeof(long long));
+                cursor += slots * sizeof(long long);
+            }
+            tables[t]->load(std::move(columns[0]), std::move(columns[1]),
+                            std::move(columns[2]), std::move(columns[3]));
+        }
+    }
+    routeCounts.clear();
+    setRouteCounting(routing);
+    if (routing) {
+        routeCounts.reserve(routeTotal);
+        for (uint64_t i = 0; i < routeTotal; i++) {
+            uint64_t route;
+            long long count;
+            std::memcpy(&route, routes.data() + 8 + i * 16, sizeof(route));
+            std::memcpy(&count, routes.data() + 16 + i * 16, sizeof(count));
+            routeCounts.add(route, count);
+        }
+    }
+    setCalendarCounting(calendar);
+    if (calendar) {
+        zoneWeekCounts.resize(zoneTotal * HOURS_PER_WEEK);
+        std::memcpy(zoneWeekCounts.data(), weekly.data() + 8, weekly.size() - 8);
+        for (uint64_t i = 0; i < dayBlocks; i++) {
+            int64_t day;
+            uint32_t id;
+            DayCounts::Hours counts;
+            std::memcpy(&day, daily.data() + 8 + i * dayBlockBytes, sizeof(day));
+            std::memcpy(&id, daily.data() + 16 + i * dayBlockBytes, sizeof(id));
+            std::memcpy(counts.data(), daily.data() + 20 + i * dayBlockBytes, sizeof(counts));
+            for (int h = 0; h < HOURS_PER_DAY; h++) {
+                if (counts[h] != 0) {
+                    dayCounts.add(static_cast<int>(day), id, h, counts[h]);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Write a read-only view that SnapshotView can mmap and query in place.
+// Zones are renumbered in name order, and the first rankedLength entries of
+// topZones/topBusySlots are stored so common queries need no scan.
+bool TripAnalyzer::saveSnapshotView(const std::string& path, int rankedLength) const {
+    static_assert(sizeof(long long) == sizeof(int64_t), "counters are stored as int64");
+
+    if (isApproximate()) {
+        std::cerr << "Error: Snapshots need exact counts (approximate mode is on)\n";
+        return false;
+    }
+
+    uint32_t zoneTotal = static_cast<uint32_t>(zoneDictionary.size());
+
+    std::vector<uint32_t> byName(zoneTotal);
+    for (uint32_t id = 0; id < zoneTotal; id++) {
+        byName[id] = id;
+    }
+    std::sort(byName.begin(), byName.end(), [this](uint32_t a, uint32_t b) {
+        return zoneDictionary.name(a) < zoneDictionary.name(b);
+    });
+    std::vector<uint32_t> rank(zoneTotal);
+    for (uint32_t i = 0; i < zoneTotal; i++) {
+        rank[byName[i]] = i;
+    }
+
+    std::string names;
+    std::vector<uint64_t> nameOffsets(1, 0);
+    std::vector<int64_t> counts(zoneTotal);
+    std::vector<uint8_t> listed(zoneTotal);
+    std::vector<uint32_t> masks(zoneTotal);
+    std::vector<int64_t> hours(static_cast<size_t>(zoneTotal) * HOURS_PER_DAY);
+    for (uint32_t i = 0; i < zoneTotal; i++) {
+        uint32_t id = byName[i];
+        names += zoneDictionary.name(id);
+        nameOffsets.push_back(names.size());
+        counts[i] = zoneCounts[id];
+        listed[i] = zoneListed[id] ? 1 : 0;
+        masks[i] = zoneHourMask[id];
+        std::memcpy(&hours[static_cast<size_t>(i) * HOURS_PER_DAY], zoneHourCounts[id].data(),
+                    sizeof(zoneHourCounts[id]));
+    }
+
+    std::vector<uint32_t> rankedZones;
+    std::vector<ZoneCount> topZoneRows = computeTopZones(rankedLength);
+    for (const auto& row : topZoneRows) {
+        rankedZones.push_back(rank[zoneDictionary.find(row.zone)]);
+    }
+    std::vector<uint32_t> rankedSlots;
+    std::vector<SlotCount> topSlotRows = computeTopBusySlots(rankedLength);
+    for (const auto& row : topSlotRows) {
+        rankedSlots.push_back(rank[zoneDictionary.find(row.zone)] * HOURS_PER_DAY + row.hour);
+    }
+
+    SnapshotViewHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "TRIPVIEW", 8);
+    header.version = SNAPSHOT_VIEW_VERSION;
+    header.zoneCount = zoneTotal;
+    header.totalRecords = totalRecords;
+    header.validRecords = validRecords;
+    header.skippedRecords = skippedRecords;
+
+    // Each array lands on an 8-byte boundary after the header
+    std::string image(sizeof(header), '\0');
+    auto place = [&image](const void* data, size_t bytes) {
+        image.append((8 - image.size() % 8) % 8, '\0');
+        uint64_t offset = image.size();
+        image.append(static_cast<const char*>(data), bytes);
+        return offset;
+    };
+
+    header.namesBytes = names.size();
+    header.namesOffset = place(names.data(), names.size());
+    header.nameOffsetsOffset = place(nameOffsets.data(), nameOffsets.size() * sizeof(uint64_t));
+    header.zoneCountsOffset = place(counts.data(), counts.size() * sizeof(int64_t));
+    header.zoneListedOffset = place(listed.data(), listed.size());
+    header.hourMasksOffset = place(masks.data(), masks.size() * sizeof(uint32_t));
+    header.hourCountsOffset = place(hours.data(), hours.size() * sizeof(int64_t));
+    header.topZonesLength = rankedZones.size();
+    header.topZonesComplete = rankedLength <= 0 || topZoneRows.size() < static_cast<size_t>(rankedLength);
+    header.topZonesOffset = place(rankedZones.data(), rankedZones.size() * sizeof(uint32_t));
+    header.topSlotsLength = rankedSlots.size();
+    header.topSlotsComplete = rankedLength <= 0 || topSlotRows.size() < static_cast<size_t>(rankedLength);
+    header.topSlotsOffset = place(rankedSlots.data(), rankedSlots.size() * sizeof(uint32_t));
+    image.append((8 - image.size() % 8) % 8, '\0');
+
+    std::memcpy(&image[0], &header, sizeof(header));
+    return writeFileAtomically(path, image);
+}
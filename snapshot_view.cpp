@@ -0,0 +1,168 @@
+#include "snapshot_view.h"
+#include "top_k.h"
+#include <iostream>
+#include <cstring>
+
+SnapshotView::SnapshotView()
+    : header(nullptr), names(nullptr), nameOffsets(nullptr), zoneCounts(nullptr),
+      zoneListed(nullptr), hourMasks(nullptr), hourCounts(nullptr),
+      rankedZones(nullptr), rankedSlots(nullptr) {}
+
+// True if [offset, offset + bytes) lies inside the file and is 8-byte aligned
+static bool validRange(uint64_t offset, uint64_t bytes, size_t fileSize) {
+    return offset % 8 == 0 && offset <= fileSize && bytes <= fileSize - offset;
+}
+
+bool SnapshotView::open(const std::string& path) {
+    close();
+
+    if (!file.open(path)) {
+        std::cerr << "Error: Cannot map snapshot view '" << path << "'\n";
+        return false;
+    }
+
+    const char* base = file.view().data();
+    size_t size = file.size();
+    const SnapshotViewHeader* h = reinterpret_cast<const SnapshotViewHeader*>(base);
+
+    const int hours = TripAnalyzer::HOURS_PER_DAY;
+    bool valid = size >= sizeof(SnapshotViewHeader) &&
+                 std::memcmp(h->magic, "TRIPVIEW", 8) == 0 &&
+                 h->version == SNAPSHOT_VIEW_VERSION;
+    if (valid) {
+        uint64_t zones = h->zoneCount;
+        valid = validRange(h->namesOffset, h->namesBytes, size) &&
+                validRange(h->nameOffsetsOffset, (zones + 1) * sizeof(uint64_t), size) &&
+                validRange(h->zoneCountsOffset, zones * sizeof(int64_t), size) &&
+                validRange(h->zoneListedOffset, zones * sizeof(uint8_t), size) &&
+                validRange(h->hourMasksOffset, zones * sizeof(uint32_t), size) &&
+                validRange(h->hourCountsOffset, zones * hours * sizeof(int64_t), size) &&
+                h->topZonesLength <= size / sizeof(uint32_t) && h->topSlotsLength <= size / sizeof(uint32_t) &&
+                validRange(h->topZonesOffset, h->topZonesLength * sizeof(uint32_t), size) &&
+                validRange(h->topSlotsOffset, h->topSlotsLength * sizeof(uint32_t), size);
+    }
+
+    // Everything the queries index with: name offsets ascending within the
+    // names, masks within 24 hours, ranked entries within the tables
+    if (valid) {
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + h->nameOffsetsOffset);
+        const uint32_t* masks = reinterpret_cast<const uint32_t*>(base + h->hourMasksOffset);
+        const uint32_t* topIds = reinterpret_cast<const uint32_t*>(base + h->topZonesOffset);
+        const uint32_t* topSlots = reinterpret_cast<const uint32_t*>(base + h->topSlotsOffset);
+        uint64_t zones = h->zoneCount;
+        valid = offsets[0] == 0 && offsets[zones] == h->namesBytes;
+        for (uint64_t id = 0; valid && id < zones; id++) {
+            valid = offsets[id] <= offsets[id + 1] && (masks[id] >> hours) == 0;
+        }
+        for (uint64_t i = 0; valid && i < h->topZonesLength; i++) {
+            valid = topIds[i] < zones;
+        }
+        for (uint64_t i = 0; valid && i < h->topSlotsLength; i++) {
+            valid = topSlots[i] < zones * hours;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Error: Invalid snapshot view '" << path << "'\n";
+        file.close();
+        return false;
+    }
+
+    header = h;
+    names = base + h->namesOffset;
+    nameOffsets = reinterpret_cast<const uint64_t*>(base + h->nameOffsetsOffset);
+    zoneCounts = reinterpret_cast<const int64_t*>(base + h->zoneCountsOffset);
+    zoneListed = reinterpret_cast<const uint8_t*>(base + h->zoneListedOffset);
+    hourMasks = reinterpret_cast<const uint32_t*>(base + h->hourMasksOffset);
+    hourCounts = reinterpret_cast<const int64_t*>(base + h->hourCountsOffset);
+    rankedZones = reinterpret_cast<const uint32_t*>(base + h->topZonesOffset);
+    rankedSlots = reinterpret_cast<const uint32_t*>(base + h->topSlotsOffset);
+    return true;
+}
+
+void SnapshotView::close() {
+    file.close();
+    header = nullptr;
+}
+
+// Get top k zones: straight from the precomputed list when it covers k
+std::vector<ZoneCount> SnapshotView::topZones(int k) const {
+    std::vector<ZoneCount> result;
+    if (header == nullptr) {
+        return result;
+    }
+
+    bool covered = header->topZonesComplete || (k > 0 && static_cast<uint64_t>(k) <= header->topZonesLength);
+    if (covered) {
+        uint64_t n = header->topZonesLength;
+        if (k > 0 && static_cast<uint64_t>(k) < n) {
+            n = k;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t id = rankedZones[i];
+            result.push_back({std::string(zoneName(id)), zoneCounts[id]});
+        }
+        return result;
+    }
+
+    // Zone IDs follow name order, so ties break on the ID alone
+    struct Candidate {
+        long long count;
+        uint32_t id;
+    };
+    auto better = [](const Candidate& a, const Candidate& b) {
+        return a.count != b.count ? a.count > b.count : a.id < b.id;
+    };
+    auto top = makeTopK<Candidate>(k > 0 ? static_cast<size_t>(k) : 0, better);
+    for (uint32_t id = 0; id < header->zoneCount; id++) {
+        if (zoneListed[id]) {
+            top.push({zoneCounts[id], id});
+        }
+    }
+    for (const auto& c : top.take()) {
+        result.push_back({std::string(zoneName(c.id)), c.count});
+    }
+    return result;
+}
+
+// Get top k busy slots: straight from the precomputed list when it covers k
+std::vector<SlotCount> SnapshotView::topBusySlots(int k) const {
+    const int hours = TripAnalyzer::HOURS_PER_DAY;
+    std::vector<SlotCount> result;
+    if (header == nullptr) {
+        return result;
+    }
+
+    bool covered = header->topSlotsComplete || (k > 0 && static_cast<uint64_t>(k) <= header->topSlotsLength);
+    if (covered) {
+        uint64_t n = header->topSlotsLength;
+        if (k > 0 && static_cast<uint64_t>(k) < n) {
+            n = k;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t slot = rankedSlots[i];
+            result.push_back({std::string(zoneName(slot / hours)), static_cast<int>(slot % hours),
+                              hourCounts[slot]});
+        }
+        return result;
+    }
+
+    // zone * 24 + hour orders by zone name, then hour
+    struct Candidate {
+        long long count;
+        uint32_t slot;
+    };
+    auto better = [](const Candidate& a, const Candidate& b) {
+        return a.count != b.count ? a.count > b.count : a.slot < b.slot;
+    };
+    auto top = makeTopK<Candidate>(k > 0 ? static_cast<size_t>(k) : 0, better);
+    for (uint32_t id = 0; id < header->zoneCount; id++) {
+        for (uint32_t mask = hourMasks[id]; mask != 0; mask &= mask - 1) {
+            uint32_t slot = id * hours + __builtin_ctz(mask);
+            top.push({hourCounts[slot], slot});
+        }
+    }
+    for (const auto& c : top.take()) {
+        result.push_back({std::string(zoneName(c.slot / hours)), static_cast<int>(c.slot % hours), c.count});
+    }
+    return result;
+}
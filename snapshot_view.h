@@ -0,0 +1,87 @@
+#ifndef SNAPSHOT_VIEW_H
+#define SNAPSHOT_VIEW_H
+
+#include "trip_analyzer.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// On-disk layout of a query view (written by TripAnalyzer::saveSnapshotView).
+// Every array starts on an 8-byte boundary and is used in place after mmap:
+//
+//   names        zone name bytes, sorted ascending (so zone ID order = name order)
+//   nameOffsets  u64[zoneCount + 1] into names
+//   zoneCounts   i64[zoneCount]
+//   zoneListed   u8[zoneCount]       zone has a total (appears in topZones)
+//   hourMasks    u32[zoneCount]      bit h = (zone, h) slot exists
+//   hourCounts   i64[zoneCount * 24] zone-major
+//   topZones     u32[topZonesLength] zone IDs in topZones order
+//   topSlots     u32[topSlotsLength] zone * 24 + hour in topBusySlots order
+struct SnapshotViewHeader {
+    char magic[8];              // "TRIPVIEW"
+    uint32_t version;
+    uint32_t zoneCount;
+    int64_t totalRecords;
+    int64_t validRecords;
+    int64_t skippedRecords;
+    uint64_t namesOffset;
+    uint64_t namesBytes;
+    uint64_t nameOffsetsOffset;
+    uint64_t zoneCountsOffset;
+    uint64_t zoneListedOffset;
+    uint64_t hourMasksOffset;
+    uint64_t hourCountsOffset;
+    uint64_t topZonesOffset;
+    uint64_t topZonesLength;
+    uint64_t topZonesComplete;  // 1 if the list holds every listed zone
+    uint64_t topSlotsOffset;
+    uint64_t topSlotsLength;
+    uint64_t topSlotsComplete;  // 1 if the list holds every slot
+};
+
+const uint32_t SNAPSHOT_VIEW_VERSION = 1;
+
+// Read-only analyzer over a mapped view file. Opening does no
+// deserialization, only one pass over the offsets, masks and ranked lists
+// to check they stay in bounds, and processes opening the same file share
+// its pages.
+class SnapshotView {
+private:
+    MappedFile file;
+    const SnapshotViewHeader* header;
+    const char* names;
+    const uint64_t* nameOffsets;
+    const int64_t* zoneCounts;
+    const uint8_t* zoneListed;
+    const uint32_t* hourMasks;
+    const int64_t* hourCounts;
+    const uint32_t* rankedZones;
+    const uint32_t* rankedSlots;
+
+public:
+    SnapshotView();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    std::vector<ZoneCount> topZones(int k = 10) const;
+    std::vector<SlotCount> topBusySlots(int k = 10) const;
+
+    // 0 (or empty) while no view is open
+    long long getTotalRecords() const { return header ? header->totalRecords : 0; }
+    long long getValidRecords() const { return header ? header->validRecords : 0; }
+    long long getSkippedRecords() const { return header ? header->skippedRecords : 0; }
+
+    size_t zoneCount() const { return header ? header->zoneCount : 0; }
+    std::string_view zoneName(uint32_t id) const {
+        if (id >= zoneCount()) {
+            return std::string_view();
+        }
+        return std::string_view(names + nameOffsets[id], nameOffsets[id + 1] - nameOffsets[id]);
+    }
+};
+
+#endif // SNAPSHOT_VIEW_H
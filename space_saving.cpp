@@ -0,0 +1,221 @@
+#include "space_saving.h"
+#include "hash_util.h"
+#include <algorithm>
+
+SpaceSaving::SpaceSaving() : limit(0), observed(0) {
+    clear();
+}
+
+void SpaceSaving::setCapacity(size_t capacity) {
+    limit = capacity;
+    clear();
+}
+
+void SpaceSaving::clear() {
+    observed = 0;
+    heap.clear();
+    hashes.clear();
+    slotOf.clear();
+
+    size_t tableSize = 2;
+    while (tableSize < limit * 2) {
+        tableSize *= 2;
+    }
+    slots.assign(tableSize, 0);
+    heap.reserve(limit);
+    hashes.reserve(limit);
+    slotOf.reserve(limit);
+}
+
+static uint64_t keyHash(std::string_view name, int tag) {
+    return hashBytes(name, static_cast<uint64_t>(tag));
+}
+
+// Heap index of the key, or NOT_FOUND
+size_t SpaceSaving::find(std::string_view name, int tag, uint64_t h) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = static_cast<size_t>(h) & mask; slots[i] != 0; i = (i + 1) & mask) {
+        size_t index = slots[i] - 1;
+        if (hashes[index] == h && heap[index].tag == tag && heap[index].name == name) {
+            return index;
+        }
+    }
+    return NOT_FOUND;
+}
+
+size_t SpaceSaving::emptySlot(uint64_t h) const {
+    size_t mask = slots.size() - 1;
+    size_t i = static_cast<size_t>(h) & mask;
+    while (slots[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Remove a table entry, shifting later entries of the probe run back so that
+// lookups never stop early at the hole
+void SpaceSaving::eraseSlot(size_t slot) {
+    size_t mask = slots.size() - 1;
+    slots[slot] = 0;
+    for (size_t j = (slot + 1) & mask; slots[j] != 0; j = (j + 1) & mask) {
+        size_t index = slots[j] - 1;
+        size_t home = static_cast<size_t>(hashes[index]) & mask;
+        if (((j - home) & mask) >= ((j - slot) & mask)) {
+            slots[slot] = slots[j];
+            slotOf[index] = static_cast<uint32_t>(slot);
+            slots[j] = 0;
+            slot = j;
+        }
+    }
+}
+
+void SpaceSaving::swapEntries(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    std::swap(hashes[a], hashes[b]);
+    std::swap(slotOf[a], slotOf[b]);
+    slots[slotOf[a]] = static_cast<uint32_t>(a + 1);
+    slots[slotOf[b]] = static_cast<uint32_t>(b + 1);
+}
+
+void SpaceSaving::siftUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap[parent].count <= heap[i].count) {
+            break;
+        }
+        swapEntries(i, parent);
+        i = parent;
+    }
+}
+
+void SpaceSaving::siftDown(size_t i) {
+    size_t n = heap.size();
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < n && heap[left].count < heap[smallest].count) {
+            smallest = left;
+        }
+        if (right < n && heap[right].count < heap[smallest].count) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        swapEntries(i, smallest);
+        i = smallest;
+    }
+}
+
+void SpaceSaving::add(std::string_view name, int tag) {
+    if (limit == 0) {
+        return;
+    }
+    observed++;
+
+    uint64_t h = keyHash(name, tag);
+    size_t index = find(name, tag, h);
+    if (index != NOT_FOUND) {
+        heap[index].count++;
+        siftDown(index);
+        return;
+    }
+
+    if (heap.size() < limit) {
+        size_t slot = emptySlot(h);
+        index = heap.size();
+        heap.push_back({std::string(name), tag, 1, 0});
+        hashes.push_back(h);
+        slotOf.push_back(static_cast<uint32_t>(slot));
+        slots[slot] = static_cast<uint32_t>(index + 1);
+        siftUp(index);
+        return;
+    }
+
+    // Full: the new key takes over the minimum, inheriting its count as error
+    long long minimum = heap[0].count;
+    eraseSlot(slotOf[0]);
+    size_t slot = emptySlot(h);
+    heap[0].name.assign(name.data(), name.size());
+    heap[0].tag = tag;
+    heap[0].count = minimum + 1;
+    heap[0].error = minimum;
+    hashes[0] = h;
+    slotOf[0] = static_cast<uint32_t>(slot);
+    slots[slot] = 1;
+    siftDown(0);
+}
+
+long long SpaceSaving::estimate(std::string_view name, int tag) const {
+    size_t index = find(name, tag, keyHash(name, tag));
+    return index != NOT_FOUND ? heap[index].count : floor();
+}
+
+// Mergeable summaries (Agarwal et al.): a key missing from one side may have
+// occurred up to that side's floor() times there, so that is added to both
+// its count and its error. The best `capacity` keys are kept.
+void SpaceSaving::merge(const SpaceSaving& other) {
+    if (other.heap.empty()) {
+        observed += other.observed;
+        return;
+    }
+    if (limit == 0) {
+        setCapacity(other.limit);
+    }
+
+    long long ownFloor = floor();
+    long long otherFloor = other.floor();
+
+    std::vector<Entry> combined;
+    combined.reserve(heap.size() + other.heap.size());
+    for (size_t i = 0; i < heap.size(); i++) {
+        const Entry& e = heap[i];
+        size_t j = other.find(e.name, e.tag, hashes[i]);
+        if (j != NOT_FOUND) {
+            combined.push_back({e.name, e.tag, e.count + other.heap[j].count, e.error + other.heap[j].error});
+        } else {
+            combined.push_back({e.name, e.tag, e.count + otherFloor, e.error + otherFloor});
+        }
+    }
+    for (size_t j = 0; j < other.heap.size(); j++) {
+        const Entry& e = other.heap[j];
+        if (find(e.name, e.tag, other.hashes[j]) == NOT_FOUND) {
+            combined.push_back({e.name, e.tag, e.count + ownFloor, e.error + ownFloor});
+        }
+    }
+
+    long long total = observed + other.observed;
+    rebuild(combined);
+    observed = total;
+}
+
+// Replace the contents with the best `limit` of entries
+void SpaceSaving::rebuild(std::vector<Entry>& entries) {
+    // Ties go to the smaller name/tag so the result never depends on input order
+    auto better = [](const Entry& a, const Entry& b) {
+        if (a.count != b.count) {
+            return a.count > b.count;
+        }
+        if (a.name != b.name) {
+            return a.name < b.name;
+        }
+        return a.tag < b.tag;
+    };
+    std::sort(entries.begin(), entries.end(), better);
+    if (entries.size() > limit) {
+        entries.resize(limit);
+    }
+
+    clear();
+
+    // Ascending counts already satisfy the heap property
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        uint64_t h = keyHash(it->name, it->tag);
+        size_t slot = emptySlot(h);
+        slots[slot] = static_cast<uint32_t>(heap.size() + 1);
+        heap.push_back(std::move(*it));
+        hashes.push_back(h);
+        slotOf.push_back(static_cast<uint32_t>(slot));
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef SPACE_SAVING_H
+#define SPACE_SAVING_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Space-Saving heavy-hitters summary (Metwally et al.) over (name, tag) keys,
+// e.g. (zone, 0) or (zone, hour). At most `capacity` keys are monitored, so
+// memory does not grow with the number of distinct keys.
+//
+// For every monitored key: count - error <= true count <= count, and
+// error <= N / capacity where N is the number of adds. A key with error 0 has
+// been monitored since its first occurrence, so its count is exact. A key that
+// is not monitored has a true count of at most floor(), so every key seen
+// more than N / capacity times is guaranteed to be monitored.
+class SpaceSaving {
+public:
+    struct Entry {
+        std::string name;
+        int tag;
+        long long count;
+        long long error;
+    };
+
+private:
+    size_t limit;
+    long long observed;
+
+    // Min-heap on count; the root is the next key to evict
+    std::vector<Entry> heap;
+    std::vector<uint64_t> hashes;   // Per heap entry
+    std::vector<uint32_t> slotOf;   // Per heap entry: its hash table slot
+
+    // Linear probing table of heap index + 1 (0 = empty), at most half full
+    std::vector<uint32_t> slots;
+
+    size_t find(std::string_view name, int tag, uint64_t h) const;
+    size_t emptySlot(uint64_t h) const;
+    void eraseSlot(size_t slot);
+    void swapEntries(size_t a, size_t b);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+    void rebuild(std::vector<Entry>& entries);
+
+public:
+    static const size_t NOT_FOUND = SIZE_MAX;
+
+    SpaceSaving();
+
+    // Set the number of monitored keys (0 = disabled); drops all state
+    void setCapacity(size_t capacity);
+    size_t capacity() const { return limit; }
+
+    void add(std::string_view name, int tag);
+
+    // Combine with a summary of another part of the stream. The bounds above
+    // still hold with N = the total adds of both.
+    void merge(const SpaceSaving& other);
+
+    // Count of a monitored key, else floor() (an upper bound either way)
+    long long estimate(std::string_view name, int tag) const;
+
+    // Monitored keys in no particular order
+    const std::vector<Entry>& entries() const { return heap; }
+
+    // Upper bound on the true count of any key that is not monitored
+    long long floor() const { return heap.size() < limit ? 0 : heap[0].count; }
+    long long total() const { return observed; }
+
+    void clear();
+};
+
+#endif // SPACE_SAVING_H
@@ -1,10 +1,17 @@
 #include "trip_analyzer.h"
+#include "simd_scan.h"
+#include "snapshot_view.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cassert>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <iomanip>
+#include <random>
+#include <cstring>
+#include <iterator>
 
 // Helper to create test files
 void createTestFile(const std::string& filename, const std::vector<std::string>& lines) {
@@ -219,13 +226,1153 @@ bool testSlotCounting() {
     return result;
 }
 
+// Test 9: Parallel ingest matches serial ingest
+bool testParallelIngest() {
+    std::cout << "Test 9: Parallel ingest... ";
+    
+    std::ofstream file("test_parallel.csv");
+    file << "TripID,PickupZoneID,PickupTime\n";
+    for (int i = 0; i < 200000; i++) {
+        if (i % 97 == 0) {
+            file << i << ",,2024-01-01 10:00\n"; // Dirty row
+            continue;
+        }
+        int hour = (i * 7) % 24;
+        file << i << ",ZONE_" << (i % 1013) << ",2024-01-01 "
+             << std::setw(2) << std::setfill('0') << hour << ":30\n";
+    }
+    file.close();
+    
+    TripAnalyzer serial;
+    serial.ingestFile("test_parallel.csv");
+    
+    TripAnalyzer parallel;
+    parallel.setThreadCount(4);
+    parallel.ingestFile("test_parallel.csv");
+    
+    auto zonesA = serial.topZones(50);
+    auto zonesB = parallel.topZones(50);
+    auto slotsA = serial.topBusySlots(50);
+    auto slotsB = parallel.topBusySlots(50);
+    
+    bool result = (serial.getTotalRecords() == parallel.getTotalRecords()) &&
+                  (serial.getValidRecords() == parallel.getValidRecords()) &&
+                  (serial.getSkippedRecords() == parallel.getSkippedRecords()) &&
+                  (zonesA.size() == zonesB.size()) && (slotsA.size() == slotsB.size());
+    for (size_t i = 0; result && i < zonesA.size(); i++) {
+        result = (zonesA[i].zone == zonesB[i].zone) && (zonesA[i].count == zonesB[i].count);
+    }
+    for (size_t i = 0; result && i < slotsA.size(); i++) {
+        result = (slotsA[i].zone == slotsB[i].zone) && (slotsA[i].hour == slotsB[i].hour) &&
+                 (slotsA[i].count == slotsB[i].count);
+    }
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    std::remove("test_parallel.csv");
+    return result;
+}
+
+// Test 10: Cached query results follow later updates
+bool testQueryCache() {
+    std::cout << "Test 10: Query cache invalidation... ";
+    
+    createTestFile("test_cache.csv", {
+        "1,ZONE_A,2024-01-01 08:30",
+        "2,ZONE_A,2024-01-01 09:30",
+        "3,ZONE_B,2024-01-01 10:30",
+        "4,ZONE_C,2024-01-01 11:30"
+    });
+    
+    TripAnalyzer analyzer;
+    analyzer.ingestFile("test_cache.csv");
+    
+    auto all = analyzer.topZones(10);
+    auto top1 = analyzer.topZones(1); // Truncated from the cached top-10
+    bool result = (all.size() == 3) && (top1.size() == 1) && (top1[0].zone == "ZONE_A");
+    
+    analyzer.addZoneCount("ZONE_C", 5);
+    auto updated = analyzer.topZones(1);
+    result = result && (updated.size() == 1) && (updated[0].zone == "ZONE_C") && (updated[0].count == 6);
+    
+    analyzer.topBusySlots(5);
+    analyzer.addZoneHourCount("ZONE_B", 10, 3);
+    auto slots = analyzer.topBusySlots(1);
+    result = result && (slots.size() == 1) && (slots[0].zone == "ZONE_B") && (slots[0].count == 4);
+    
+    analyzer.clear();
+    result = result && analyzer.topZones(10).empty() && analyzer.topBusySlots(10).empty();
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    std::remove("test_cache.csv");
+    return result;
+}
+
+// Test 11: Headerless 6-column SmallTrips layout
+bool testSmallTripsLayout() {
+    std::cout << "Test 11: 6-column layout detection... ";
+    
+    std::ofstream file("test_layout.csv");
+    file << "1000001,ZONE_A,ZONE_X,2024-01-01 00:00,16.0,74.9\n";   // First row is data
+    file << "1000002,ZONE_A,ZONE_Y,2024-01-01 23:59,19.3,81.2\n";
+    file << "1000003,ZONE_B,2024-01-01 10:04,10.5,50.4\n";          // Missing dropoff
+    file << "1000004,ZONE_B,ZONE_Z,Not-A-Date,10.6,51.1\n";         // Bad time
+    file << "INVALID_ID,ZONE_B,ZONE_Z,2024-06-01 10:15,SevenKm,9.9\n";
+    file.close();
+    
+    TripAnalyzer analyzer;
+    analyzer.ingestFile("test_layout.csv");
+    
+    auto zones = analyzer.topZones(10);
+    auto slots = analyzer.topBusySlots(10);
+    
+    bool result = (analyzer.getTotalRecords() == 5) && (analyzer.getValidRecords() == 3) &&
+                  (analyzer.getColumns().pickupTime == 3) &&
+                  (zones.size() == 2) && (zones[0].zone == "ZONE_A") && (zones[0].count == 2) &&
+                  (slots.size() == 3) && (slots[0].zone == "ZONE_A") && (slots[0].hour == 0) &&
+                  (slots[1].hour == 23) && (slots[2].zone == "ZONE_B") && (slots[2].hour == 10);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    std::remove("test_layout.csv");
+    return result;
+}
+
+// Test 12: Vectorized delimiter scan agrees with the scalar scan
+bool testDelimiterScan() {
+    std::cout << "Test 12: Delimiter scan (" << delimiterScannerName() << ")... ";
+    
+    std::mt19937 rng(7);
+    const char alphabet[] = {',', '\n', 'a', '0', ' ', '\r', ':', '-'};
+    std::uniform_int_distribution<int> pick(0, sizeof(alphabet) - 1);
+    
+    bool result = true;
+    for (int round = 0; round < 1000 && result; round++) {
+        char block[SCAN_BLOCK_BYTES];
+        for (char& c : block) {
+            c = alphabet[pick(rng)];
+        }
+        DelimiterMasks fast, reference;
+        scanDelimiters(block, fast);
+        scanDelimitersScalar(block, reference);
+        result = (fast.commas == reference.commas) && (fast.newlines == reference.newlines);
+    }
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 13: Buffer and stream ingest match file ingest
+bool testInMemoryIngest() {
+    std::cout << "Test 13: In-memory ingest... ";
+    
+    std::string header = "TripID,PickupZoneID,PickupTime\n";
+    std::string batch1 = "1,ZONE_A,2024-01-01 08:30\n2,ZONE_B,2024-01-01 09:30\n";
+    std::string batch2 = "3,ZONE_A,2024-01-01 08:45\n4,,2024-01-01 09:30\n5,ZONE_C,2024-01-01 10:00";
+    
+    // Headerless batches are counted in full
+    TripAnalyzer buffered;
+    buffered.ingestBuffer(batch1);
+    buffered.ingestBuffer(batch2);
+    
+    std::istringstream stream(header + batch1 + batch2);
+    TripAnalyzer streamed;
+    streamed.ingestStream(stream);
+    
+    std::ofstream file("test_memory.csv");
+    file << header << batch1 << batch2;
+    file.close();
+    TripAnalyzer filed;
+    filed.ingestFile("test_memory.csv");
+    
+    bool result = true;
+    for (const TripAnalyzer* a : {&buffered, &streamed, &filed}) {
+        auto zones = a->topZones(10);
+        auto slots = a->topBusySlots(1);
+        result = result && (a->getTotalRecords() == 5) && (a->getValidRecords() == 4) &&
+                 (zones.size() == 3) && (zones[0].zone == "ZONE_A") && (zones[0].count == 2) &&
+                 (slots.size() == 1) && (slots[0].zone == "ZONE_A") && (slots[0].hour == 8);
+    }
+    
+    // A later batch starting with a bad row: counted as skipped, layout kept
+    TripAnalyzer wide;
+    wide.ingestBuffer("TripID,PickupZoneID,DropoffZoneID,PickupDateTime,Distance,Fare\n"
+                      "1,ZONE_A,ZONE_B,2024-01-01 08:30,1.0,5.0\n");
+    wide.ingestBuffer("2,ZONE_A,ZONE_B,not-a-time,1.0,5.0\n"
+                      "3,ZONE_B,ZONE_A,2024-01-01 09:30,1.0,5.0\n");
+    wide.ingestBuffer("4,ZONE_B,ZONE_A,2024-01-01 10:30,1.0,5.0\n");
+    result = result && (wide.getTotalRecords() == 4) && (wide.getSkippedRecords() == 1) &&
+             (wide.getColumns().pickupTime == 3) && (wide.countFor("ZONE_B") == 2);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    std::remove("test_memory.csv");
+    return result;
+}
+
+// Test 14: Snapshot round trip
+bool testSnapshotRoundTrip() {
+    std::cout << "Test 14: Snapshot save/load... ";
+    
+    TripAnalyzer original;
+    original.ingestFile("SmallTrips.csv");
+    original.addZoneHourCount("ONLY_SLOTS", 5, 2); // Zone without a total
+    bool result = original.saveSnapshot("test_state.snap");
+    
+    TripAnalyzer restored;
+    restored.addZoneCount("STALE", 100);
+    result = result && restored.loadSnapshot("test_state.snap");
+    
+    auto zonesA = original.topZones(0);
+    auto zonesB = restored.topZones(0);
+    auto slotsA = original.topBusySlots(0);
+    auto slotsB = restored.topBusySlots(0);
+    
+    result = result && (original.getTotalRecords() == restored.getTotalRecords()) &&
+             (original.getValidRecords() == restored.getValidRecords()) &&
+             (original.getSkippedRecords() == restored.getSkippedRecords()) &&
+             (zonesA.size() == zonesB.size()) && (slotsA.size() == slotsB.size());
+    for (size_t i = 0; result && i < zonesA.size(); i++) {
+        result = (zonesA[i].zone == zonesB[i].zone) && (zonesA[i].count == zonesB[i].count);
+    }
+    for (size_t i = 0; result && i < slotsA.size(); i++) {
+        result = (slotsA[i].zone == slotsB[i].zone) && (slotsA[i].hour == slotsB[i].hour) &&
+                 (slotsA[i].count == slotsB[i].count);
+    }
+    
+    // A damaged file is rejected and the loaded state survives
+    std::ofstream("test_bad.snap") << "TRIPSNAP-not-really";
+    result = result && !restored.loadSnapshot("test_bad.snap") &&
+             (restored.getValidRecords() == original.getValidRecords());
+    
+    // So is an hour mask naming an hour past 23 (section 5, first zone)
+    std::ifstream in("test_state.snap", std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (size_t at = 16; at + 16 <= image.size();) {
+        uint32_t tag;
+        uint64_t length;
+        std::memcpy(&tag, &image[at], sizeof(tag));
+        std::memcpy(&length, &image[at + 8], sizeof(length));
+        if (tag == 5) {
+            image[at + 16 + 3] |= 0x40; // Bit 30
+            break;
+        }
+        at += 16 + (length + 7) / 8 * 8;
+    }
+    std::ofstream("test_bad.snap", std::ios::binary) << image;
+    result = result && !restored.loadSnapshot("test_bad.snap") &&
+             (restored.getValidRecords() == original.getValidRecords());
+    
+    // Modes with no zones yet survive the trip
+    TripAnalyzer modes, reloaded;
+    modes.setCalendarCounting(true);
+    modes.setValueCounting(true);
+    modes.setRouteCounting(true);
+    result = result && modes.saveSnapshot("test_bad.snap") && reloaded.loadSnapshot("test_bad.snap") &&
+             reloaded.isCountingCalendar() && reloaded.isCountingValues() && reloaded.isCountingRoutes();
+    
+    // A version 1 file is read only if it has none of the later sections
+    std::ifstream modesIn("test_bad.snap", std::ios::binary);
+    image.assign(std::istreambuf_iterator<char>(modesIn), std::istreambuf_iterator<char>());
+    modesIn.close();
+    image[8] = 1;
+    std::ofstream("test_bad.snap", std::ios::binary) << image;
+    result = result && !reloaded.loadSnapshot("test_bad.snap") && reloaded.isCountingCalendar();
+    TripAnalyzer plain;
+    plain.addZoneCount("ZONE_A", 3);
+    result = result && plain.saveSnapshot("test_bad.snap");
+    std::ifstream plainIn("test_bad.snap", std::ios::binary);
+    image.assign(std::istreambuf_iterator<char>(plainIn), std::istreambuf_iterator<char>());
+    plainIn.close();
+    image[8] = 1;
+    std::ofstream("test_bad.snap", std::ios::binary) << image;
+    result = result && reloaded.loadSnapshot("test_bad.snap") && !reloaded.isCountingCalendar() &&
+             (reloaded.topZones(1).size() == 1) && (reloaded.topZones(1)[0].count == 3);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    std::remove("test_state.snap");
+    std::remove("test_bad.snap");
+    return result;
+}
+
+// Test 15: Mapped snapshot view answers like the analyzer
+bool testSnapshotView() {
+    std::cout << "Test 15: Snapshot view queries... ";
+    
+    TripAnalyzer analyzer;
+    analyzer.ingestFile("SmallTrips.csv");
+    bool result = analyzer.saveSnapshotView("test_view.snap", 5);
+    
+    SnapshotView view;
+    result = result && view.open("test_view.snap") &&
+             (view.getValidRecords() == analyzer.getValidRecords());
+    
+    // k = 3 and 5 come from the stored lists, larger k and k = 0 scan the arrays
+    for (int k : {3, 5, 20, 0}) {
+        auto zonesA = analyzer.topZones(k);
+        auto zonesB = view.topZones(k);
+        auto slotsA = analyzer.topBusySlots(k);
+        auto slotsB = view.topBusySlots(k);
+        result = result && (zonesA.size() == zonesB.size()) && (slotsA.size() == slotsB.size());
+        for (size_t i = 0; result && i < zonesA.size(); i++) {
+            result = (zonesA[i].zone == zonesB[i].zone) && (zonesA[i].count == zonesB[i].count);
+        }
+        for (size_t i = 0; result && i < slotsA.size(); i++) {
+            result = (slotsA[i].zone == slotsB[i].zone) && (slotsA[i].hour == slotsB[i].hour) &&
+                     (slotsA[i].count == slotsB[i].count);
+        }
+    }
+    
+    view.close();
+    result = result && (view.getValidRecords() == 0) && (view.zoneCount() == 0) && view.topZones(3).empty();
+    
+    // A ranked zone ID past the zone table is caught when opening
+    std::ifstream in("test_view.snap", std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint64_t ranked;
+    std::memcpy(&ranked, &image[offsetof(SnapshotViewHeader, topZonesOffset)], sizeof(ranked));
+    std::memset(&image[ranked], 0xff, sizeof(uint32_t));
+    std::ofstream("test_view_bad.snap", std::ios::binary) << image;
+    result = result && !view.open("test_view_bad.snap") && !view.isOpen();
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    std::remove("test_view.snap");
+    std::remove("test_view_bad.snap");
+    return result;
+}
+
+// Test 16: Merging shards matches one analyzer over all rows
+bool testShardMerge() {
+    std::cout << "Test 16: Shard merge... ";
+    
+    std::string header = "TripID,PickupZoneID,PickupTime\n";
+    std::string day1 = "1,ZONE_A,2024-01-01 08:30\n2,ZONE_B,2024-01-01 09:30\n3,,bad\n";
+    std::string day2 = "4,ZONE_B,2024-01-02 09:10\n5,ZONE_C,2024-01-02 10:00\n";
+    std::string day3 = "6,ZONE_A,2024-01-03 08:00\n7,ZONE_B,2024-01-03 09:45\n";
+    
+    TripAnalyzer combined;
+    combined.ingestBuffer(header + day1 + day2 + day3);
+    
+    TripAnalyzer shard1, shard2, shard3;
+    shard1.ingestBuffer(day1);
+    shard2.ingestBuffer(day2);
+    shard3.ingestBuffer(day3);
+    
+    TripAnalyzer pairwise;
+    pairwise.merge(shard1);
+    pairwise.merge(shard2);
+    pairwise.merge(shard3);
+    
+    TripAnalyzer kway;
+    kway.topZones(10); // Cached before the merge, must be invalidated
+    kway.merge({&shard1, &shard2, &shard3});
+    
+    bool result = true;
+    for (const TripAnalyzer* a : {&pairwise, &kway}) {
+        auto zonesA = combined.topZones(10);
+        auto zonesB = a->topZones(10);
+        auto slotsA = combined.topBusySlots(10);
+        auto slotsB = a->topBusySlots(10);
+        result = result && (a->getTotalRecords() == 7) && (a->getValidRecords() == 6) &&
+                 (a->getSkippedRecords() == 1) &&
+                 (zonesA.size() == zonesB.size()) && (slotsA.size() == slotsB.size());
+        for (size_t i = 0; result && i < zonesA.size(); i++) {
+            result = (zonesA[i].zone == zonesB[i].zone) && (zonesA[i].count == zonesB[i].count);
+        }
+        for (size_t i = 0; result && i < slotsA.size(); i++) {
+            result = (slotsA[i].zone == slotsB[i].zone) && (slotsA[i].hour == slotsB[i].hour) &&
+                     (slotsA[i].count == slotsB[i].count);
+        }
+    }
+    
+    // Merging an analyzer into itself doubles it
+    pairwise.merge(pairwise);
+    result = result && (pairwise.getValidRecords() == 12) && (pairwise.topZones(1)[0].count == 6);
+    
+    // Self entries in a k-way merge add the state from before the merge
+    long long before = kway.getValidRecords();
+    kway.merge({&kway, &kway});
+    result = result && (kway.getValidRecords() == 3 * before);
+    
+    // An empty analyzer switches on the shard's modes but keeps its own
+    // settings, and one it has set differently is refused
+    TripAnalyzer calendar, target, routed;
+    calendar.setCalendarCounting(true);
+    calendar.ingestBuffer("TripID,PickupZoneID,PickupTime\n1,ZONE_A,2024-03-01 08:00\n");
+    target.setDeduplication(100);
+    routed.setRouteCounting(true);
+    result = result && target.merge(calendar) && target.isCountingCalendar() && target.isDeduplicating() &&
+             (target.getValidRecords() == 1) && !routed.merge(calendar) && routed.isCountingRoutes() &&
+             !routed.isCountingCalendar();
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 17: Multi-file and directory ingest match one concatenated file
+bool testMultiFileIngest() {
+    std::cout << "Test 17: Multi-file ingest... ";
+    
+    std::filesystem::create_directory("test_files");
+    std::vector<std::string> filenames;
+    std::string all;
+    for (int f = 0; f < 5; f++) {
+        std::string name = "test_files/hour_" + std::to_string(f) + ".csv";
+        std::ofstream file(name);
+        file << "TripID,PickupZoneID,PickupTime\n";
+        // Uneven sizes so the largest-first scheduling has something to do
+        for (int i = 0; i < (f + 1) * 40; i++) {
+            std::string row = std::to_string(i) + ",Z" + std::to_string((i * 7 + f) % 9) +
+                              ",2024-01-01 " + (f < 10 ? "0" : "") + std::to_string(f) + ":15\n";
+            file << row;
+            all += row;
+        }
+        file << "broken,row\n";
+        all += "broken,row\n";
+        filenames.push_back(name);
+    }
+    std::ofstream("test_files/notes.txt") << "1,NOT_A_TRIP,2024-01-01 00:00\n";
+    
+    TripAnalyzer single;
+    single.ingestBuffer(all);
+    
+    TripAnalyzer byList;
+    byList.setThreadCount(3);
+    byList.ingestFiles(filenames);
+    
+    TripAnalyzer byDirectory;
+    byDirectory.setThreadCount(2);
+    byDirectory.ingestDirectory("test_files", "hour_*.csv");
+    
+    bool result = true;
+    for (const TripAnalyzer* a : {&byList, &byDirectory}) {
+        auto zonesA = single.topZones(0);
+        auto zonesB = a->topZones(0);
+        auto slotsA = single.topBusySlots(0);
+        auto slotsB = a->topBusySlots(0);
+        result = result && (a->getTotalRecords() == single.getTotalRecords()) &&
+                 (a->getValidRecords() == single.getValidRecords()) &&
+                 (a->getSkippedRecords() == 5) &&
+                 (zonesA.size() == zonesB.size()) && (slotsA.size() == slotsB.size());
+        for (size_t i = 0; result && i < zonesA.size(); i++) {
+            result = (zonesA[i].zone == zonesB[i].zone) && (zonesA[i].count == zonesB[i].count);
+        }
+        for (size_t i = 0; result && i < slotsA.size(); i++) {
+            result = (slotsA[i].zone == slotsB[i].zone) && (slotsA[i].hour == slotsB[i].hour) &&
+                     (slotsA[i].count == slotsB[i].count);
+        }
+    }
+    
+    std::filesystem::remove_all("test_files");
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 18: Follow mode picks up appended rows once each, survives rotation
+bool testFollowMode() {
+    std::cout << "Test 18: Follow mode... ";
+    
+    {
+        std::ofstream file("test_follow.csv");
+        file << "TripID,PickupZoneID,PickupTime\n";
+        file << "1,ZONE_A,2024-01-01 08:00\n";
+        file << "2,ZONE_B,2024-01-01 09:00\n";
+        file << "3,ZONE_A,2024-01-0"; // Still being written
+    }
+    
+    TripAnalyzer analyzer;
+    bool result = analyzer.followFile("test_follow.csv") && analyzer.isFollowing() &&
+                  (analyzer.getTotalRecords() == 2) && (analyzer.pollFollow() == 0);
+    auto before = analyzer.topZones(1);
+    
+    {
+        std::ofstream file("test_follow.csv", std::ios::app);
+        file << "1 08:30\n4,ZONE_A,2024-01-01 10:00\n";
+    }
+    result = result && (analyzer.pollFollow() == 2) && (analyzer.getValidRecords() == 4) &&
+             (before[0].count == 1) && (analyzer.topZones(1)[0].count == 3);
+    
+    // Truncated and rewritten: counted from the top, header detected again
+    {
+        std::ofstream file("test_follow.csv", std::ios::trunc);
+        file << "TripID,PickupZoneID,PickupTime\n5,ZONE_C,2024-01-02 11:00\n";
+    }
+    result = result && (analyzer.pollFollow() == 1) && (analyzer.getTotalRecords() == 5) &&
+             (analyzer.getSkippedRecords() == 0);
+    
+    analyzer.stopFollowing();
+    result = result && !analyzer.isFollowing() && (analyzer.pollFollow() == 0);
+    
+    std::remove("test_follow.csv");
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 19: Approximate mode stays within the Space-Saving error bound
+bool testApproximateMode() {
+    std::cout << "Test 19: Approximate mode... ";
+    
+    // Skewed data: a few heavy zones over a long tail of one-off zones
+    std::ostringstream csv;
+    csv << "TripID,PickupZoneID,PickupTime\n";
+    std::mt19937 rng(7);
+    int id = 0;
+    for (int i = 0; i < 3000; i++) {
+        int pick = static_cast<int>(rng() % 10);
+        std::string zone = (pick < 6) ? "HEAVY_" + std::to_string(pick % 3)
+                                      : "TAIL_" + std::to_string(i);
+        csv << id++ << "," << zone << ",2024-01-01 " << std::setw(2) << std::setfill('0')
+            << (pick % 3) * 5 << ":00\n";
+    }
+    
+    TripAnalyzer exact;
+    exact.ingestBuffer(csv.str());
+    
+    const size_t capacity = 64;
+    TripAnalyzer approx;
+    approx.setApproximate(capacity);
+    approx.ingestBuffer(csv.str());
+    
+    auto truth = exact.topZones(0);
+    auto zones = approx.topZones(3);
+    auto slots = approx.topBusySlots(3);
+    long long bound = approx.getValidRecords() / static_cast<long long>(capacity);
+    
+    bool result = approx.isApproximate() && !exact.isApproximate() && truth[0].exact &&
+                  (approx.getValidRecords() == exact.getValidRecords()) &&
+                  (zones.size() == 3) && (slots.size() == 3) &&
+                  (approx.topZones(0).size() == capacity);
+    for (size_t i = 0; result && i < zones.size(); i++) {
+        // Heavy hitters come out in the exact order with bounded overestimates
+        result = (zones[i].zone == truth[i].zone) && (zones[i].count >= truth[i].count) &&
+                 (zones[i].count - truth[i].count <= bound) &&
+                 (!zones[i].exact || zones[i].count == truth[i].count);
+        result = result && (slots[i].zone == zones[i].zone) && (slots[i].count >= truth[i].count);
+    }
+    
+    // With room for every key the summary is exact
+    TripAnalyzer roomy;
+    roomy.setApproximate(5000);
+    roomy.ingestBuffer(csv.str());
+    auto all = roomy.topZones(0);
+    result = result && (all.size() == truth.size());
+    for (size_t i = 0; result && i < all.size(); i++) {
+        result = all[i].exact && (all[i].zone == truth[i].zone) && (all[i].count == truth[i].count);
+    }
+    
+    // Merged summaries keep the bound
+    TripAnalyzer left, right;
+    left.setApproximate(capacity);
+    right.setApproximate(capacity);
+    left.ingestBuffer(csv.str());
+    right.ingestBuffer(csv.str());
+    left.merge(right);
+    auto merged = left.topZones(1);
+    result = result && (merged[0].zone == truth[0].zone) && (merged[0].count >= 2 * truth[0].count) &&
+             (merged[0].count - 2 * truth[0].count <= left.getValidRecords() / static_cast<long long>(capacity));
+    
+    // Exact and approximate analyzers do not mix, in either direction; an
+    // empty analyzer takes the mode of what it merges
+    TripAnalyzer fresh;
+    result = result && !exact.merge(right) && !exact.isApproximate() &&
+             (exact.getValidRecords() == right.getValidRecords()) && exact.topZones(1)[0].exact &&
+             !right.merge(exact) && (right.getValidRecords() == exact.getValidRecords()) &&
+             !left.merge({&right, &exact});
+    result = result && fresh.merge(right) && fresh.isApproximate() &&
+             (fresh.topZones(1)[0].count == right.topZones(1)[0].count);
+    
+    result = result && !approx.saveSnapshot("test_approx.snap");
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 20: Point queries, exact and through the Count-Min Sketch
+bool testPointQueries() {
+    std::cout << "Test 20: Point queries... ";
+    
+    std::ostringstream csv;
+    csv << "TripID,PickupZoneID,PickupTime\n";
+    for (int i = 0; i < 4000; i++) {
+        int zone = (i % 5 == 0) ? 0 : i % 200;
+        csv << i << ",Z" << zone << ",2024-01-01 " << std::setw(2) << std::setfill('0')
+            << (i % 24) << ":00\n";
+    }
+    
+    TripAnalyzer exact;
+    exact.ingestBuffer(csv.str());
+    bool result = (exact.countFor("Z0") == exact.topZones(1)[0].count) &&
+                  (exact.countFor("Z7") == 20) && (exact.countFor("Z7", 7) == 7) &&
+                  (exact.countFor("Z7", 8) == 0) && (exact.countFor("NOPE") == 0) &&
+                  (exact.countFor("Z7", 24) == 0) && (exact.countFor("Z7", -1) == 0);
+    
+    for (const auto& slot : exact.topBusySlots(50)) {
+        result = result && (exact.countFor(slot.zone, slot.hour) == slot.count);
+    }
+    
+    // Sketch estimates never undercount and stay close on this input
+    TripAnalyzer sketched;
+    sketched.setApproximate(32);
+    result = result && !exact.setCountSketch(1024, 4) && sketched.setCountSketch(1024, 4);
+    sketched.ingestBuffer(csv.str());
+    long long slack = 3 * sketched.getValidRecords() / 1024;
+    for (int z = 0; result && z < 200; z++) {
+        std::string zone = "Z" + std::to_string(z);
+        long long truth = exact.countFor(zone);
+        long long estimate = sketched.countFor(zone);
+        result = (estimate >= truth) && (estimate - truth <= slack);
+        for (int h = 0; result && h < 24; h += 5) {
+            long long slotTruth = exact.countFor(zone, h);
+            long long slotEstimate = sketched.countFor(zone, h);
+            result = (slotEstimate >= slotTruth) && (slotEstimate - slotTruth <= slack);
+        }
+    }
+    
+    // Too late to start a sketch, and shards with and without one do not mix
+    TripAnalyzer unsketched;
+    unsketched.setApproximate(32);
+    unsketched.ingestBuffer(csv.str());
+    result = result && !unsketched.setCountSketch(1024, 4) &&
+             !unsketched.merge(sketched) && !sketched.merge(unsketched) &&
+             (sketched.countFor("Z0") >= exact.countFor("Z0")) &&
+             (sketched.countFor("Z0") - exact.countFor("Z0") <= slack);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 21: HyperLogLog distinct counts, merged and saved with the state
+bool testDistinctCounts() {
+    std::cout << "Test 21: Distinct counts... ";
+    
+    // 20000 rows, 15000 distinct trip IDs, 700 zones, 100 zones per hour
+    std::ostringstream first, second;
+    first << "TripID,PickupZoneID,PickupTime\n";
+    second << "TripID,PickupZoneID,PickupTime\n";
+    for (int i = 0; i < 20000; i++) {
+        int hour = i % 7;
+        std::ostringstream& out = (i % 2 == 0) ? first : second;
+        out << "T" << (i % 15000) << ",Z" << (hour * 100 + i % 100) << ",2024-01-01 "
+            << std::setw(2) << std::setfill('0') << hour << ":00\n";
+    }
+    
+    auto near = [](long long estimate, long long truth) {
+        return estimate >= truth * 95 / 100 && estimate <= truth * 105 / 100;
+    };
+    
+    TripAnalyzer off;
+    off.ingestBuffer(first.str());
+    bool result = !off.isCountingDistinct() && (off.estimateDistinctTrips() == 0);
+    
+    TripAnalyzer left, right;
+    left.setDistinctCounting();
+    right.setDistinctCounting();
+    left.ingestBuffer(first.str());
+    right.ingestBuffer(second.str());
+    left.merge(right);
+    
+    result = result && left.isCountingDistinct() && near(left.estimateDistinctTrips(), 15000) &&
+             near(left.estimateDistinctZones(), 700) && near(left.estimateDistinctZones(3), 100) &&
+             (left.estimateDistinctZones(12) == 0);
+    
+    // Distinct counting is not switched on (or off) by a merge
+    TripAnalyzer coarse;
+    coarse.setDistinctCounting(10);
+    coarse.ingestBuffer(second.str());
+    result = result && !off.merge(left) && !off.isCountingDistinct() && !left.merge(off) &&
+             !left.merge(coarse) && near(left.estimateDistinctTrips(), 15000);
+    
+    TripAnalyzer loaded;
+    result = result && left.saveSnapshot("test_distinct.snap") && loaded.loadSnapshot("test_distinct.snap") &&
+             (loaded.estimateDistinctTrips() == left.estimateDistinctTrips()) &&
+             (loaded.estimateDistinctZones(3) == left.estimateDistinctZones(3));
+    
+    std::remove("test_distinct.snap");
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 22: Re-delivered TripIDs are suppressed and counted separately
+bool testDeduplication() {
+    std::cout << "Test 22: TripID dedup... ";
+    
+    // 3000 trips, then a retry of the last 500, a stray repeat and a bad row
+    std::ostringstream csv;
+    csv << "TripID,PickupZoneID,PickupTime\n";
+    for (int i = 0; i < 3000; i++) {
+        csv << "T" << i << ",Z" << (i % 13) << ",2024-01-01 " << std::setw(2) << std::setfill('0')
+            << (i % 24) << ":00\n";
+    }
+    for (int i = 2500; i < 3000; i++) {
+        csv << " T" << i << " ,Z" << (i % 13) << ",2024-01-01 " << std::setw(2) << std::setfill('0')
+            << (i % 24) << ":00\n";
+    }
+    csv << "T7,Z7,2024-01-01 07:00\n";
+    csv << "T9,,2024-01-01 09:00\n";
+    
+    TripAnalyzer plain;
+    plain.ingestBuffer(csv.str());
+    
+    TripAnalyzer dedup;
+    dedup.setDeduplication(4000);
+    dedup.setThreadCount(4);
+    dedup.ingestBuffer(csv.str());
+    
+    TripAnalyzer reference;
+    std::ostringstream once;
+    for (int i = 0; i < 3000; i++) {
+        once << "T" << i << ",Z" << (i % 13) << ",2024-01-01 " << std::setw(2) << std::setfill('0')
+             << (i % 24) << ":00\n";
+    }
+    reference.ingestBuffer(once.str());
+    
+    bool result = dedup.isDeduplicating() && (plain.getDuplicateRecords() == 0) &&
+                  (plain.getValidRecords() == 3501) &&
+                  (dedup.getTotalRecords() == 3502) && (dedup.getDuplicateRecords() == 501) &&
+                  (dedup.getValidRecords() == 3000) && (dedup.getSkippedRecords() == 1);
+    
+    auto zonesA = reference.topZones(0);
+    auto zonesB = dedup.topZones(0);
+    result = result && (zonesA.size() == zonesB.size());
+    for (size_t i = 0; result && i < zonesA.size(); i++) {
+        result = (zonesA[i].zone == zonesB[i].zone) && (zonesA[i].count == zonesB[i].count);
+    }
+    
+    // Off again: everything counts
+    dedup.setDeduplication(0);
+    dedup.clear();
+    dedup.ingestBuffer(csv.str());
+    result = result && !dedup.isDeduplicating() && (dedup.getValidRecords() == 3501);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 23: Day-of-week and per-date counters
+bool testCalendarCounts() {
+    std::cout << "Test 23: Calendar counters... ";
+    
+    // 2024-03-04 is a Monday, 2024-03-10 a Sunday
+    std::string csv = "TripID,PickupZoneID,PickupTime\n"
+                      "1,ZONE_A,2024-03-04 08:00\n"
+                      "2,ZONE_A,2024-03-11 08:30\n"
+                      "3,ZONE_A,2024-03-10 08:15\n"
+                      "4,ZONE_B,2024-03-10 08:45\n"
+                      "5,ZONE_B,2024-03-10 09:00\n"
+                      "6,ZONE_B,2024-02-29 23:59\n"
+                      "7,ZONE_C,2024-02-30 10:00\n"; // Invalid date, still a valid hour
+    
+    TripAnalyzer analyzer;
+    analyzer.setCalendarCounting(true);
+    analyzer.ingestBuffer(csv);
+    
+    auto weekly = analyzer.topWeeklySlots(10);
+    auto daily = analyzer.topDailyZones(10);
+    
+    bool result = analyzer.isCountingCalendar() && (analyzer.getValidRecords() == 7) &&
+                  (weekly.size() == 5) &&
+                  (weekly[0].zone == "ZONE_A") && (weekly[0].dayOfWeek == 0) &&
+                  (weekly[0].hour == 8) && (weekly[0].count == 2) &&
+                  (weekly[1].zone == "ZONE_A") && (weekly[1].dayOfWeek == 6) && (weekly[1].count == 1) &&
+                  (weekly[2].zone == "ZONE_B") && (weekly[2].dayOfWeek == 3) && (weekly[2].hour == 23) &&
+                  (daily.size() == 5) &&
+                  (daily[0].zone == "ZONE_B") && (daily[0].date == "2024-03-10") && (daily[0].count == 2) &&
+                  (daily[1].zone == "ZONE_A") && (daily[1].date == "2024-03-04") &&
+                  (daily[4].zone == "ZONE_B") && (daily[4].date == "2024-02-29");
+    
+    // Split, merged and reloaded: same answers
+    TripAnalyzer first, second, merged, loaded;
+    first.setCalendarCounting(true);
+    second.setCalendarCounting(true);
+    size_t cut = csv.find("4,ZONE_B");
+    first.ingestBuffer(csv.substr(0, cut));
+    second.ingestBuffer(csv.substr(cut));
+    merged.merge({&second, &first});
+    result = result && merged.saveSnapshot("test_calendar.snap") && loaded.loadSnapshot("test_calendar.snap");
+    for (const TripAnalyzer* a : {&merged, &loaded}) {
+        auto w = a->topWeeklySlots(10);
+        auto d = a->topDailyZones(10);
+        result = result && a->isCountingCalendar() && (w.size() == weekly.size()) && (d.size() == daily.size());
+        for (size_t i = 0; result && i < w.size(); i++) {
+            result = (w[i].zone == weekly[i].zone) && (w[i].dayOfWeek == weekly[i].dayOfWeek) &&
+                     (w[i].hour == weekly[i].hour) && (w[i].count == weekly[i].count);
+        }
+        for (size_t i = 0; result && i < d.size(); i++) {
+            result = (d[i].zone == daily[i].zone) && (d[i].date == daily[i].date) && (d[i].count == daily[i].count);
+        }
+    }
+    std::remove("test_calendar.snap");
+    
+    // Off by default
+    TripAnalyzer plain;
+    plain.ingestBuffer(csv);
+    result = result && plain.topWeeklySlots(10).empty() && plain.topDailyZones(10).empty();
+    
+    // A merge does not turn the calendar counters on or off
+    result = result && !plain.merge(merged) && !plain.isCountingCalendar() && !merged.merge(plain);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 24: Top zones and slots over a date range
+bool testDateRangeQueries() {
+    std::cout << "Test 24: Date range queries... ";
+    
+    std::string csv = "TripID,PickupZoneID,PickupTime\n"
+                      "1,ZONE_A,2024-03-01 08:00\n"
+                      "2,ZONE_A,2024-03-01 08:30\n"
+                      "3,ZONE_B,2024-03-02 09:00\n"
+                      "4,ZONE_B,2024-03-03 09:15\n"
+                      "5,ZONE_B,2024-03-03 10:00\n"
+                      "6,ZONE_C,2024-03-05 10:00\n";
+    
+    TripAnalyzer analyzer;
+    analyzer.setCalendarCounting(true);
+    analyzer.ingestBuffer(csv);
+    
+    // Whole range agrees with the unrestricted queries
+    auto zones = analyzer.topZones(10, "2024-01-01", "2024-12-31");
+    auto slots = analyzer.topBusySlots(10, "2024-01-01", "2024-12-31");
+    auto allZones = analyzer.topZones(10);
+    auto allSlots = analyzer.topBusySlots(10);
+    bool result = (zones.size() == allZones.size()) && (slots.size() == allSlots.size());
+    for (size_t i = 0; result && i < zones.size(); i++) {
+        result = (zones[i].zone == allZones[i].zone) && (zones[i].count == allZones[i].count);
+    }
+    for (size_t i = 0; result && i < slots.size(); i++) {
+        result = (slots[i].zone == allSlots[i].zone) && (slots[i].hour == allSlots[i].hour) &&
+                 (slots[i].count == allSlots[i].count);
+    }
+    
+    // Inclusive bounds; zones without trips in the range are left out
+    zones = analyzer.topZones(10, "2024-03-01", "2024-03-02");
+    result = result && (zones.size() == 2) &&
+             (zones[0].zone == "ZONE_A") && (zones[0].count == 2) &&
+             (zones[1].zone == "ZONE_B") && (zones[1].count == 1);
+    slots = analyzer.topBusySlots(10, "2024-03-03", "2024-03-05");
+    result = result && (slots.size() == 3) &&
+             (slots[0].zone == "ZONE_B") && (slots[0].hour == 9) && (slots[0].count == 1) &&
+             (slots[1].zone == "ZONE_B") && (slots[1].hour == 10) &&
+             (slots[2].zone == "ZONE_C") && (slots[2].hour == 10);
+    result = result && analyzer.topZones(10, "2024-03-04", "2024-03-04").empty() &&
+             analyzer.topZones(10, "2025-01-01", "2025-01-31").empty();
+    
+    // Bad or reversed bounds
+    result = result && analyzer.topZones(10, "2024-03-05", "2024-03-01").empty() &&
+             analyzer.topZones(10, "2024-02-30", "2024-03-05").empty() &&
+             analyzer.topBusySlots(10, "March", "2024-03-05").empty();
+    
+    // New rows are picked up by the next range query
+    analyzer.ingestBuffer("TripID,PickupZoneID,PickupTime\n"
+                          "7,ZONE_C,2024-03-04 10:00\n"
+                          "8,ZONE_C,2024-02-28 10:00\n");
+    zones = analyzer.topZones(1, "2024-03-04", "2024-03-05");
+    result = result && (zones.size() == 1) && (zones[0].zone == "ZONE_C") && (zones[0].count == 2) &&
+             (analyzer.topZones(10, "2024-02-01", "2024-02-29").size() == 1);
+    
+    // Late rows between queries: an existing day, and a new zone on a new first day
+    analyzer.ingestBuffer("TripID,PickupZoneID,PickupTime\n"
+                          "9,ZONE_A,2024-03-02 08:00\n"
+                          "10,ZONE_D,2024-01-15 07:00\n");
+    zones = analyzer.topZones(10, "2024-03-01", "2024-03-02");
+    result = result && (zones.size() == 2) && (zones[0].zone == "ZONE_A") && (zones[0].count == 3) &&
+             (zones[1].zone == "ZONE_B") && (zones[1].count == 1);
+    zones = analyzer.topZones(10, "2024-01-01", "2024-02-29");
+    result = result && (zones.size() == 2) && (zones[0].zone == "ZONE_C") && (zones[1].zone == "ZONE_D");
+    
+    // Merged and reloaded analyzers answer the same
+    TripAnalyzer first, second, merged, loaded;
+    first.setCalendarCounting(true);
+    second.setCalendarCounting(true);
+    size_t cut = csv.find("4,ZONE_B");
+    first.ingestBuffer(csv.substr(0, cut));
+    second.ingestBuffer(csv.substr(cut));
+    merged.merge({&second, &first});
+    result = result && merged.saveSnapshot("test_range.snap") && loaded.loadSnapshot("test_range.snap");
+    for (const TripAnalyzer* a : {&merged, &loaded}) {
+        auto z = a->topZones(10, "2024-03-02", "2024-03-03");
+        auto s = a->topBusySlots(1, "2024-03-01", "2024-03-01");
+        result = result && (z.size() == 1) && (z[0].zone == "ZONE_B") && (z[0].count == 3) &&
+                 (s.size() == 1) && (s[0].zone == "ZONE_A") && (s[0].hour == 8) && (s[0].count == 2);
+    }
+    std::remove("test_range.snap");
+    
+    // 1000 zones over two months plus an outlier row from 1900: only the days
+    // with rows are stored, and every range still sums correctly
+    std::ostringstream wide;
+    wide << "TripID,PickupZoneID,PickupTime\n";
+    for (int i = 0; i < 3000; i++) {
+        int day = i % 60;
+        wide << i << ",ZONE" << std::setw(4) << std::setfill('0') << (i % 1000) << ",2024-"
+             << (day < 31 ? "01-" : "02-") << std::setw(2) << (day < 31 ? day + 1 : day - 30)
+             << " " << std::setw(2) << (i % 24) << ":00\n";
+    }
+    wide << "3000,ZONE0001,1900-01-01 05:00\n";
+    TripAnalyzer outlier;
+    outlier.setCalendarCounting(true);
+    outlier.ingestBuffer(wide.str());
+    zones = outlier.topZones(1000, "2024-01-01", "2024-01-10");
+    long long rangeTotal = 0;
+    for (const auto& z : zones) {
+        rangeTotal += z.count;
+    }
+    result = result && (rangeTotal == 500) && (outlier.topZones(1000, "1900-01-01", "2199-12-31").size() == 1000);
+    slots = outlier.topBusySlots(10, "1900-01-01", "1999-12-31");
+    result = result && (slots.size() == 1) && (slots[0].zone == "ZONE0001") && (slots[0].hour == 5);
+    zones = outlier.topZones(1, "2024-02-29", "2024-02-29");
+    result = result && (zones.size() == 1) && (zones[0].count == 1);
+    
+    // Needs calendar counting
+    TripAnalyzer plain;
+    plain.ingestBuffer(csv);
+    result = result && plain.topZones(10, "2024-01-01", "2024-12-31").empty();
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 25: Sliding-window top zones
+bool testSlidingWindow() {
+    std::cout << "Test 25: Sliding window... ";
+    
+    TripAnalyzer analyzer;
+    analyzer.setWindow(24);
+    analyzer.ingestBuffer("TripID,PickupZoneID,PickupTime\n"
+                          "1,ZONE_A,2024-03-01 00:10\n"
+                          "2,ZONE_A,2024-03-01 00:20\n"
+                          "3,ZONE_A,2024-03-01 00:30\n"
+                          "4,ZONE_B,2024-03-01 18:00\n"
+                          "5,ZONE_B,2024-03-01 20:00\n"
+                          "6,ZONE_C,2024-03-01 23:00\n");
+    
+    // Window ends at 2024-03-01 23:xx
+    auto day = analyzer.topZonesInWindow(10, 24);
+    auto six = analyzer.topZonesInWindow(10, 6);
+    auto hour = analyzer.topZonesInWindow(10, 1);
+    bool result = analyzer.isWindowed() &&
+                  (day.size() == 3) && (day[0].zone == "ZONE_A") && (day[0].count == 3) &&
+                  (six.size() == 2) && (six[0].zone == "ZONE_B") && (six[0].count == 2) &&
+                  (hour.size() == 1) && (hour[0].zone == "ZONE_C") &&
+                  (analyzer.topZonesInWindow(10).size() == 3);
+    
+    // Moving on a few hours expires the midnight bucket; all-time counts stay
+    analyzer.ingestBuffer("7,ZONE_C,2024-03-02 02:00\n"
+                          "8,ZONE_A,2024-02-29 12:00\n"); // Late: already outside the window
+    day = analyzer.topZonesInWindow(10);
+    result = result && (day.size() == 2) &&
+             (day[0].zone == "ZONE_B") && (day[0].count == 2) &&
+             (day[1].zone == "ZONE_C") && (day[1].count == 2) &&
+             (analyzer.getLateRecords() == 1) &&
+             (analyzer.topZones(1)[0].zone == "ZONE_A") && (analyzer.topZones(1)[0].count == 4);
+    
+    // A jump past the whole window empties it
+    analyzer.ingestBuffer("9,ZONE_D,2024-03-05 09:00\n");
+    day = analyzer.topZonesInWindow(10);
+    result = result && (day.size() == 1) && (day[0].zone == "ZONE_D");
+    
+    // Merged shards: the later watermark wins and old hours drop out
+    TripAnalyzer early, late, merged;
+    early.setWindow(6);
+    late.setWindow(6);
+    early.ingestBuffer("TripID,PickupZoneID,PickupTime\n"
+                       "1,ZONE_A,2024-03-01 08:00\n"
+                       "2,ZONE_B,2024-03-01 11:00\n");
+    late.ingestBuffer("TripID,PickupZoneID,PickupTime\n"
+                      "3,ZONE_B,2024-03-01 14:00\n");
+    merged.setWindow(6);
+    merged.merge({&early, &late});
+    auto m = merged.topZonesInWindow(10);
+    result = result && (m.size() == 1) && (m[0].zone == "ZONE_B") && (m[0].count == 2) &&
+             (merged.getLateRecords() == 0);
+    
+    // Windows of different lengths do not merge
+    TripAnalyzer longer;
+    longer.setWindow(12);
+    longer.ingestBuffer("TripID,PickupZoneID,PickupTime\n1,ZONE_A,2024-03-01 08:00\n");
+    result = result && !longer.merge(early) && !early.merge(longer) && (longer.getValidRecords() == 1);
+    
+    // clear() keeps the mode, setWindow(0) turns it off
+    analyzer.clear();
+    result = result && analyzer.isWindowed() && analyzer.topZonesInWindow(10).empty();
+    analyzer.setWindow(0);
+    analyzer.ingestBuffer("TripID,PickupZoneID,PickupTime\n1,ZONE_A,2024-03-01 08:00\n");
+    result = result && !analyzer.isWindowed() && analyzer.topZonesInWindow(10).empty();
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 26: Origin-destination route counts
+bool testRouteCounts() {
+    std::cout << "Test 26: Route counts... ";
+    
+    std::string csv = "1,ZONE_A,ZONE_X,2024-01-01 08:00,1.0,5.0\n"
+                      "2,ZONE_A,ZONE_X,2024-01-01 09:00,1.0,5.0\n"
+                      "3,ZONE_B,ZONE_X,2024-01-01 09:00,1.0,5.0\n"
+                      "4,ZONE_A,ZONE_B,2024-01-01 10:00,1.0,5.0\n"
+                      "5,ZONE_B,ZONE_A,2024-01-01 10:00,1.0,5.0\n"
+                      "6,ZONE_C, ,2024-01-01 11:00,1.0,5.0\n"; // No dropoff: counted, no route
+    
+    TripAnalyzer analyzer;
+    analyzer.setRouteCounting(true);
+    analyzer.ingestBuffer(csv);
+    
+    // Ties: pickup zone, then dropoff zone ascending
+    auto routes = analyzer.topRoutes(10);
+    auto zones = analyzer.topZones(10);
+    bool result = analyzer.isCountingRoutes() && (analyzer.getValidRecords() == 6) &&
+                  (routes.size() == 4) &&
+                  (routes[0].pickupZone == "ZONE_A") && (routes[0].dropoffZone == "ZONE_X") &&
+                  (routes[0].count == 2) &&
+                  (routes[1].pickupZone == "ZONE_A") && (routes[1].dropoffZone == "ZONE_B") &&
+                  (routes[2].pickupZone == "ZONE_B") && (routes[2].dropoffZone == "ZONE_A") &&
+                  (routes[3].pickupZone == "ZONE_B") && (routes[3].dropoffZone == "ZONE_X") &&
+                  (analyzer.countRoute("ZONE_A", "ZONE_X") == 2) &&
+                  (analyzer.countRoute("ZONE_X", "ZONE_A") == 0) &&
+                  (analyzer.countRoute("ZONE_Q", "ZONE_A") == 0);
+    
+    // Dropoff-only zones stay out of the pickup rankings
+    result = result && (zones.size() == 3) && (analyzer.countFor("ZONE_X") == 0) &&
+             (analyzer.topBusySlots(0).size() == 6);
+    
+    // Parallel, merged and reloaded analyzers agree
+    std::string big;
+    for (int i = 0; i < 3000; i++) {
+        big += csv;
+    }
+    TripAnalyzer parallel, first, second, merged, loaded;
+    parallel.setRouteCounting(true);
+    parallel.setThreadCount(4);
+    parallel.ingestBuffer(big);
+    first.setRouteCounting(true);
+    second.setRouteCounting(true);
+    first.ingestBuffer(csv.substr(0, csv.find("4,ZONE_A")));
+    second.ingestBuffer(csv.substr(csv.find("4,ZONE_A")));
+    merged.merge({&second, &first});
+    result = result && merged.saveSnapshot("test_routes.snap") && loaded.loadSnapshot("test_routes.snap");
+    std::remove("test_routes.snap");
+    for (const TripAnalyzer* a : {&parallel, &merged, &loaded}) {
+        auto r = a->topRoutes(10);
+        long long scale = (a == &parallel) ? 3000 : 1;
+        result = result && a->isCountingRoutes() && (r.size() == routes.size());
+        for (size_t i = 0; result && i < r.size(); i++) {
+            result = (r[i].pickupZone == routes[i].pickupZone) && (r[i].dropoffZone == routes[i].dropoffZone) &&
+                     (r[i].count == routes[i].count * scale);
+        }
+    }
+    
+    // Off by default, and 3-column input has no dropoff column
+    TripAnalyzer plain, threeColumn;
+    plain.ingestBuffer(csv);
+    threeColumn.setRouteCounting(true);
+    threeColumn.ingestBuffer("TripID,PickupZoneID,PickupTime\n1,ZONE_A,2024-01-01 08:00\n");
+    result = result && plain.topRoutes(10).empty() &&
+             threeColumn.topRoutes(10).empty() && (threeColumn.getValidRecords() == 1);
+    
+    // A merge does not turn route counting on or off
+    result = result && !plain.merge(analyzer) && !plain.isCountingRoutes() && !analyzer.merge(plain);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
+// Test 27: Distance and fare aggregates
+bool testValueAggregates() {
+    std::cout << "Test 27: Distance and fare aggregates... ";
+    
+    // Decimal parser
+    long long v = 0;
+    bool result = parseDecimal("74.9", v) && (v == 74900) &&
+                  parseDecimal("-3.5", v) && (v == -3500) &&
+                  parseDecimal("12", v) && (v == 12000) &&
+                  parseDecimal(".25", v) && (v == 250) &&
+                  parseDecimal("1.2345", v) && (v == 1235) &&
+                  !parseDecimal("", v) && !parseDecimal(".", v) && !parseDecimal("SevenKm", v) &&
+                  !parseDecimal("1e5", v) && !parseDecimal("1.5.2", v) && !parseDecimal("-", v);
+    
+    std::string csv = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,Distance,Fare\n"
+                      "1,ZONE_A,ZONE_X,2024-01-01 08:00,2.5,10.00\n"
+                      "2,ZONE_A,ZONE_X,2024-01-01 08:30,7.5,30.50\n"
+                      "3,ZONE_A,ZONE_X,2024-01-01 09:00, 1.0 ,5.25\n"
+                      "4,ZONE_B,ZONE_X,2024-01-01 08:00,SevenKm,60.00\n"  // Bad distance, fare still counted
+                      "5,ZONE_C,ZONE_X,2024-01-01 10:00,3.0,\n";          // No fare
+    
+    TripAnalyzer analyzer;
+    analyzer.setValueCounting(true);
+    analyzer.ingestBuffer(csv);
+    
+    auto zones = analyzer.topZonesByRevenue(10);
+    auto slots = analyzer.topBusySlotsByRevenue(10);
+    ValueSummary fareA = analyzer.fareFor("ZONE_A");
+    ValueSummary distanceA8 = analyzer.distanceFor("ZONE_A", 8);
+    result = result && analyzer.isCountingValues() && (analyzer.getValidRecords() == 5) &&
+             (zones.size() == 2) &&
+             (zones[0].zone == "ZONE_B") && (zones[0].revenue == 60.0) && (zones[0].trips == 1) &&
+             (zones[1].zone == "ZONE_A") && (zones[1].revenue == 45.75) && (zones[1].trips == 3) &&
+             (slots.size() == 3) && (slots[0].zone == "ZONE_B") &&
+             (slots[1].zone == "ZONE_A") && (slots[1].hour == 8) && (slots[1].revenue == 40.5) &&
+             (fareA.count == 3) && (fareA.min == 5.25) && (fareA.max == 30.5) && (fareA.mean() == 15.25) &&
+             (distanceA8.count == 2) && (distanceA8.sum == 10.0) &&
+             (analyzer.distanceFor("ZONE_B").count == 0) && (analyzer.fareFor("ZONE_C").count == 0) &&
+             (analyzer.distanceFor("ZONE_C").sum == 3.0) &&
+             (analyzer.fareFor("ZONE_Q").count == 0) && (analyzer.fareFor("ZONE_A", 24).count == 0);
+    
+    // Parallel, merged and reloaded: same sums to the thousandth
+    std::string big = csv;
+    std::string rows = csv.substr(csv.find('\n') + 1);
+    for (int i = 1; i < 3000; i++) {
+        big += rows;
+    }
+    TripAnalyzer parallel, first, second, merged, loaded;
+    parallel.setValueCounting(true);
+    parallel.setThreadCount(4);
+    parallel.ingestBuffer(big);
+    first.setValueCounting(true);
+    second.setValueCounting(true);
+    first.ingestBuffer(csv.substr(0, csv.find("3,ZONE_A")));
+    second.ingestBuffer(csv.substr(csv.find("3,ZONE_A")));
+    merged.merge({&second, &first});
+    result = result && merged.saveSnapshot("test_values.snap") && loaded.loadSnapshot("test_values.snap");
+    std::remove("test_values.snap");
+    auto p = parallel.topZonesByRevenue(10);
+    result = result && (p.size() == 2) && (p[1].revenue == 45.75 * 3000) && (p[1].trips == 9000);
+    for (const TripAnalyzer* a : {&merged, &loaded}) {
+        auto z = a->topZonesByRevenue(10);
+        ValueSummary fare = a->fareFor("ZONE_A", 8);
+        result = result && a->isCountingValues() && (z.size() == zones.size()) &&
+                 (z[1].revenue == 45.75) && (fare.count == 2) && (fare.min == 10.0) && (fare.max == 30.5);
+    }
+    
+    // Rows cut short before Distance or Fare are valid either way
+    std::string shortRows = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,Distance,Fare\n"
+                            "1,ZONE_A,ZONE_X,2024-01-01 08:00\n"
+                            "2,ZONE_A,ZONE_X,2024-01-01 08:00,4.0\n"
+                            "3,ZONE_A,ZONE_X,2024-01-01 08:00,4.0,9.00\n";
+    TripAnalyzer valued, unvalued;
+    valued.setValueCounting(true);
+    valued.ingestBuffer(shortRows);
+    unvalued.ingestBuffer(shortRows);
+    result = result && (valued.getValidRecords() == 3) && (unvalued.getValidRecords() == 3) &&
+             (valued.distanceFor("ZONE_A").count == 2) && (valued.fareFor("ZONE_A").count == 1);
+    
+    // Off by default
+    TripAnalyzer plain;
+    plain.ingestBuffer(csv);
+    result = result && plain.topZonesByRevenue(10).empty() && (plain.fareFor("ZONE_A").count == 0) &&
+             !plain.merge(analyzer) && !plain.isCountingValues() && !analyzer.merge(plain);
+    
+    std::cout << (result ? "PASSED" : "FAILED") << "\n";
+    return result;
+}
+
 // Main test runner
 int main() {
     std::cout << "CMP2003 Trip Analyzer - Test Suite\n";
     std::cout << "==================================\n\n";
     
     int passed = 0;
-    int total = 8;
+    int total = 27;
     
     passed += testBasicFunctionality() ? 1 : 0;
     passed += testEmptyFile() ? 1 : 0;
@@ -235,6 +1382,25 @@ int main() {
     passed += testBoundaryHours() ? 1 : 0;
     passed += testPerformance() ? 1 : 0;
     passed += testSlotCounting() ? 1 : 0;
+    passed += testParallelIngest() ? 1 : 0;
+    passed += testQueryCache() ? 1 : 0;
+    passed += testSmallTripsLayout() ? 1 : 0;
+    passed += testDelimiterScan() ? 1 : 0;
+    passed += testInMemoryIngest() ? 1 : 0;
+    passed += testSnapshotRoundTrip() ? 1 : 0;
+    passed += testSnapshotView() ? 1 : 0;
+    passed += testShardMerge() ? 1 : 0;
+    passed += testMultiFileIngest() ? 1 : 0;
+    passed += testFollowMode() ? 1 : 0;
+    passed += testApproximateMode() ? 1 : 0;
+    passed += testPointQueries() ? 1 : 0;
+    passed += testDistinctCounts() ? 1 : 0;
+    passed += testDeduplication() ? 1 : 0;
+    passed += testCalendarCounts() ? 1 : 0;
+    passed += testDateRangeQueries() ? 1 : 0;
+    passed += testSlidingWindow() ? 1 : 0;
+    passed += testRouteCounts() ? 1 : 0;
+    passed += testValueAggregates() ? 1 : 0;
     
     std::cout << "\n" << std::string(50, '=') << "\n";
     std::cout << "TEST RESULTS: " << passed << "/" << total << " tests passed\n";
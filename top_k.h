@@ -0,0 +1,58 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded selection of the k best items from a stream in O(m log k).
+// better(a, b) returns true when a ranks ahead of b. The heap keeps the
+// worst retained item on top, so most candidates are rejected with a
+// single comparison. A limit of 0 keeps everything.
+template <typename T, typename Better>
+class TopK {
+private:
+    size_t limit;
+    Better better;
+    std::vector<T> heap;
+
+public:
+    TopK(size_t limit, Better better) : limit(limit), better(std::move(better)) {
+        if (limit > 0) {
+            heap.reserve(limit);
+        }
+    }
+
+    void push(const T& item) {
+        if (limit == 0 || heap.size() < limit) {
+            heap.push_back(item);
+            if (limit != 0) {
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+            return;
+        }
+        if (better(item, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = item;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    // Retained items, best first
+    std::vector<T> take() {
+        if (limit == 0) {
+            std::sort(heap.begin(), heap.end(), better);
+        } else {
+            std::sort_heap(heap.begin(), heap.end(), better);
+        }
+        return std::move(heap);
+    }
+};
+
+template <typename T, typename Better>
+TopK<T, Better> makeTopK(size_t limit, Better better) {
+    return TopK<T, Better>(limit, std::move(better));
+}
+
+#endif // TOP_K_H
@@ -1,15 +1,29 @@
 #ifndef TRIP_ANALYZER_H
 #define TRIP_ANALYZER_H
 
+#include <array>
+#include <cstdint>
+#include <istream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 #include <utility>
+#include "zone_dictionary.h"
+#include "query_cache.h"
+#include "space_saving.h"
+#include "count_min_sketch.h"
+#include "hyper_log_log.h"
+#include "duplicate_filter.h"
+#include "sliding_window.h"
+#include "route_table.h"
+#include "value_stats.h"
+#include "day_counts.h"
 
 // Structure to hold zone count information
 struct ZoneCount {
     std::string zone;
     long long count;
+    bool exact = true; // False if count is an approximate-mode upper bound
     
     // For sorting
     bool operator<(const ZoneCount& other) const {
@@ -25,6 +39,7 @@ struct SlotCount {
     std::string zone;
     int hour;
     long long count;
+    bool exact = true;
     
     // For sorting
     bool operator<(const SlotCount& other) const {
@@ -38,26 +53,274 @@ struct SlotCount {
     }
 };
 
+// Structure to hold (zone, day of week, hour) counts
+struct WeeklySlotCount {
+    std::string zone;
+    int dayOfWeek; // 0 = Monday ... 6 = Sunday
+    int hour;
+    long long count;
+    
+    // For sorting
+    bool operator<(const WeeklySlotCount& other) const {
+        if (count != other.count) {
+            return count > other.count; // Descending by count
+        }
+        if (zone != other.zone) {
+            return zone < other.zone; // Ascending by zone
+        }
+        if (dayOfWeek != other.dayOfWeek) {
+            return dayOfWeek < other.dayOfWeek; // Monday first
+        }
+        return hour < other.hour; // Ascending by hour
+    }
+};
+
+// Structure to hold (zone, date) counts
+struct DailyZoneCount {
+    std::string zone;
+    std::string date; // "YYYY-MM-DD"
+    long long count;
+    
+    // For sorting
+    bool operator<(const DailyZoneCount& other) const {
+        if (count != other.count) {
+            return count > other.count; // Descending by count
+        }
+        if (zone != other.zone) {
+            return zone < other.zone; // Ascending by zone
+        }
+        return date < other.date; // Oldest first
+    }
+};
+
+// Structure to hold (pickup zone, dropoff zone) counts
+struct RouteCount {
+    std::string pickupZone;
+    std::string dropoffZone;
+    long long count;
+    
+    // For sorting
+    bool operator<(const RouteCount& other) const {
+        if (count != other.count) {
+            return count > other.count; // Descending by count
+        }
+        if (pickupZone != other.pickupZone) {
+            return pickupZone < other.pickupZone; // Ascending by pickup zone
+        }
+        return dropoffZone < other.dropoffZone; // Ascending by dropoff zone
+    }
+};
+
+// Structure to hold fare totals per zone
+struct ZoneRevenue {
+    std::string zone;
+    double revenue;
+    long long trips; // Trips with a valid fare
+    
+    // For sorting
+    bool operator<(const ZoneRevenue& other) const {
+        if (revenue != other.revenue) {
+            return revenue > other.revenue; // Descending by revenue
+        }
+        return zone < other.zone; // Ascending by zone name
+    }
+};
+
+// Structure to hold fare totals per (zone, hour) slot
+struct SlotRevenue {
+    std::string zone;
+    int hour;
+    double revenue;
+    long long trips;
+    
+    // For sorting
+    bool operator<(const SlotRevenue& other) const {
+        if (revenue != other.revenue) {
+            return revenue > other.revenue; // Descending by revenue
+        }
+        if (zone != other.zone) {
+            return zone < other.zone; // Ascending by zone
+        }
+        return hour < other.hour; // Ascending by hour
+    }
+};
+
+// Column positions of the fields the analyzer reads, resolved once per
+// input from its first line (-1 = column not present)
+struct CsvColumns {
+    static const int MAX_COLUMNS = 16;
+    
+    int tripId;
+    int pickupZone;
+    int dropoffZone;
+    int pickupTime;
+    int distance;
+    int fare;
+    
+    // TripID,PickupZoneID,PickupTime
+    static CsvColumns threeColumn() { return {0, 1, -1, 2, -1, -1}; }
+    
+    // TripID,PickupZoneID,DropoffZoneID,PickupDateTime,Distance,Fare
+    static CsvColumns smallTrips() { return {0, 1, 2, 3, 4, 5}; }
+};
+
+// One row located in the input: its bounds and the commas that end its
+// leading fields (only as many as the layout needs are recorded)
+struct CsvRow {
+    const char* begin;
+    const char* end;
+    const char* commas[CsvColumns::MAX_COLUMNS];
+    int commaCount;
+    
+    // Untrimmed field i; valid for i <= commaCount
+    std::string_view field(int i) const {
+        const char* start = (i == 0) ? begin : commas[i - 1] + 1;
+        const char* stop = (i < commaCount) ? commas[i] : end;
+        return std::string_view(start, stop - start);
+    }
+};
+
+// Where follow mode is in a growing file
+struct FollowState {
+    std::string path;
+    bool active = false;
+    uint64_t offset = 0;       // Bytes consumed so far
+    std::string pending;       // Partial last line waiting for its newline
+    bool atStart = true;       // Header/layout not detected yet
+    uint64_t device = 0;       // Identity of the file, to spot rotation
+    uint64_t inode = 0;
+};
+
 class TripAnalyzer {
+public:
+    static const int HOURS_PER_DAY = 24;
+    static const int DAYS_PER_WEEK = 7;
+    static const int HOURS_PER_WEEK = DAYS_PER_WEEK * HOURS_PER_DAY;
+    
 private:
-    // Data stores
-    std::unordered_map<std::string, long long> zoneCounts;
-    std::unordered_map<std::string, std::unordered_map<int, long long>> zoneHourCounts;
+    // Data stores, indexed by interned zone ID
+    ZoneDictionary zoneDictionary;
+    std::vector<long long> zoneCounts;
+    std::vector<char> zoneListed; // Zone has a zoneCounts entry (for topZones)
+    std::vector<std::array<long long, HOURS_PER_DAY>> zoneHourCounts;
+    std::vector<uint32_t> zoneHourMask; // Bit h set = (zone, h) slot exists
     
     // Statistics
     long long totalRecords;
     long long validRecords;
     long long skippedRecords;
+    long long duplicateRecords; // Suppressed by dedup, not in valid or skipped
+    
+    // Layout of the input being ingested, how many leading fields a valid row
+    // needs, and how many the enabled modes read when a row has them
+    CsvColumns columns;
+    int fieldsNeeded;
+    int fieldsRead;
+    bool readsTripId; // Dedup or distinct counting hash the TripID
+    bool layoutKnown; // Set by the first line of an input, reset for each new file or stream
+    
+    // Worker threads used by ingestFile/ingestFiles (1 = serial)
+    unsigned threadCount;
+    
+    // Bumped by every mutation; cached query results from older generations are stale.
+    // Queries fill the caches, so concurrent const calls need external locking.
+    unsigned long long generation;
+    mutable QueryCache<ZoneCount> zoneQueryCache;
+    mutable QueryCache<SlotCount> slotQueryCache;
+    
+    FollowState follow;
+    
+    // Approximate mode (capacity > 0): zone and (zone, hour) heavy hitters
+    SpaceSaving zoneSummary;
+    SpaceSaving slotSummary;
+    CountMinSketch zoneSketch;
+    CountMinSketch slotSketch;
+    
+    // Distinct counting (opt-in): TripIDs, pickup zones, pickup zones per hour
+    HyperLogLog distinctTrips;
+    HyperLogLog distinctZones;
+    std::array<HyperLogLog, HOURS_PER_DAY> distinctZonesByHour;
+    
+    // Calendar counters (opt-in), filled from the date part of PickupTime:
+    // zoneWeekCounts[zone * 168 + dayOfWeek * 24 + hour], and (zone, hour)
+    // counts for each day that has rows, keyed by zone ID
+    bool calendarCounting;
+    std::vector<uint32_t> zoneWeekCounts;
+    DayCounts dayCounts;
+    
+    // TripID dedup (opt-in)
+    DuplicateFilter duplicateFilter;
+    
+    // Zone counts over the last hours of event time (opt-in), keyed by zone ID
+    SlidingWindow recentWindow;
+    
+    // Origin-destination counts (opt-in). Dropoff zones are interned like
+    // pickup zones but stay unlisted, so they never show up in topZones.
+    bool routeCounting;
+    RouteTable routeCounts;
+    
+    // Distance and fare aggregates (opt-in), by zone ID and by zone * 24 + hour
+    bool valueCounting;
+    ValueStats zoneDistance;
+    ValueStats zoneFare;
+    ValueStats slotDistance;
+    ValueStats slotFare;
     
     // Helper functions
-    bool parseCSVLine(const std::string& line, std::string& zoneID, int& hour);
-    int extractHour(const std::string& datetime);
+    void ingestRows(std::string_view rows);
+    void ingestRowsParallel(std::string_view rows, unsigned workers);
+    void ingestChunk(std::string_view bytes, std::string& pending, bool& atStart);
+    void mergeCounts(const std::vector<const TripAnalyzer*>& shards);
+    void inheritSettings(const TripAnalyzer& parent);
+    bool sameModes(const TripAnalyzer& other) const;
+    bool adoptModes(const TripAnalyzer& other);
+    bool acceptShards(const std::vector<const TripAnalyzer*>& shards);
+    uint64_t tripKey(const CsvRow& row) const;
+    void countCalendar(uint32_t id, int day, int hour);
+    bool rangeSlotCounts(const std::string& from, const std::string& to,
+                         std::vector<unsigned long long>& slots) const;
+    void countDistinct(uint64_t tripKey, std::string_view zoneID, int hour);
+    void countValues(const CsvRow& row, uint32_t id, int hour);
+    void resizeValues(size_t zones);
+    uint32_t zoneIndex(std::string_view zone);
+    void ingestRow(const CsvRow& row);
+    std::string_view takeHeader(std::string_view data);
+    bool detectSchema(std::string_view firstLine);
+    void setColumns(const CsvColumns& layout);
+    bool parseCSVLine(const CsvRow& row, std::string_view& zoneID, int& hour);
+    int extractHour(std::string_view datetime);
+    std::vector<ZoneCount> computeTopZones(int k) const;
+    std::vector<SlotCount> computeTopBusySlots(int k) const;
+    std::vector<ZoneCount> approximateTopZones(int k) const;
+    std::vector<SlotCount> approximateTopBusySlots(int k) const;
     
 public:
     TripAnalyzer();
     
     // Main interface functions
     void ingestFile(const std::string& filename);
+    
+    // Many files at once, spread over the worker threads (see setThreadCount).
+    // The directory variant takes a glob such as "trips_*.csv".
+    void ingestFiles(const std::vector<std::string>& filenames);
+    void ingestDirectory(const std::string& directory, const std::string& pattern = "*.csv");
+    
+    // In-memory entry points sharing the same parser. A stream, like a file,
+    // is one input whose first line sets the layout. The first buffer does the
+    // same; later buffers keep that layout and skip a first line only if it
+    // names the zone and time columns, so headerless batches are fully counted
+    // even when their first row is malformed.
+    void ingestBuffer(std::string_view data);
+    void ingestStream(std::istream& in);
+    
+    // Follow mode for a file that keeps growing: followFile counts the current
+    // contents, each pollFollow counts only rows appended since (cost is
+    // proportional to the new bytes). Call pollFollow as often as the wanted
+    // latency; it returns the number of new records.
+    bool followFile(const std::string& filename);
+    long long pollFollow();
+    void stopFollowing();
+    bool isFollowing() const { return follow.active; }
     std::vector<ZoneCount> topZones(int k = 10) const;
     std::vector<SlotCount> topBusySlots(int k = 10) const;
     
@@ -76,13 +339,135 @@ public:
     long long getTotalRecords() const { return totalRecords; }
     long long getValidRecords() const { return validRecords; }
     long long getSkippedRecords() const { return skippedRecords; }
+    long long getDuplicateRecords() const { return duplicateRecords; }
+    const CsvColumns& getColumns() const { return columns; } // Layout of the last input
+    
+    // Parallel ingest: rows are split into newline-aligned byte ranges,
+    // counted on private tables per worker and merged in range order, so
+    // results are identical to the serial path. 0 = hardware concurrency.
+    void setThreadCount(unsigned threads);
+    unsigned getThreadCount() const { return threadCount; }
+    
+    // Bounded-memory approximate mode: topZones/topBusySlots come from
+    // Space-Saving summaries of `capacity` entries each (0 = exact, the
+    // default). A reported count c with exact == false satisfies
+    // true <= c <= true + N / capacity, N = valid records; any zone or slot
+    // with more than N / capacity trips is always reported. Setting the mode
+    // clears the analyzer. With several threads the per-worker summaries are
+    // merged, which keeps the same bound but may rank near-ties differently
+    // from a serial run.
+    void setApproximate(size_t capacity);
+    bool isApproximate() const { return zoneSummary.capacity() > 0; }
+    
+    // Fixed-size Count-Min Sketches answering countFor in approximate mode.
+    // An estimate never undercounts, and exceeds the true count by more than
+    // 2.72 * N / width with probability at most e^-depth. Call it after
+    // setApproximate and before ingesting; false (and no sketch) otherwise.
+    bool setCountSketch(size_t width, size_t depth = 4);
+    
+    // Approximate distinct counts over valid rows, in a few KiB per counter
+    // (relative error about 1.04 / sqrt(2^precision)). Off by default; the
+    // counters are merged with shards and stored in snapshots.
+    void setDistinctCounting(int precision = 12);
+    bool isCountingDistinct() const { return distinctTrips.enabled(); }
+    long long estimateDistinctTrips() const { return distinctTrips.estimate(); }
+    long long estimateDistinctZones() const { return distinctZones.estimate(); }
+    long long estimateDistinctZones(int hour) const;
+    
+    // Opt-in dedup on TripID: rows whose ID was seen among the last `window`
+    // trips are counted in getDuplicateRecords() instead of the counters.
+    // Size expectedTrips for the number of distinct trips; 0 = off. One
+    // filter sees every row in input order, so while dedup is on the ingest
+    // calls use a single thread and ingestFiles reads one file at a time,
+    // whatever setThreadCount says.
+    void setDeduplication(size_t expectedTrips, size_t window = 1 << 16);
+    bool isDeduplicating() const { return duplicateFilter.enabled(); }
+    
+    // Sliding-window mode for live use: zone counts over the last `hours`
+    // hours of event time (PickupTime date and hour; 0 = off), next to the
+    // all-time counters. The newest hour seen is the window's end; older
+    // hours expire as it moves, and rows already outside the window are
+    // counted in getLateRecords() only. Arrival order matters, so ingest
+    // runs serially. Exact mode only, not stored in snapshots.
+    // Any valid date moves the window's end, so a row dated far in the
+    // future (a bad clock, 2199-01-01) empties the window and makes every
+    // later row late; filter such rows out upstream if the feed can hold them.
+    void setWindow(size_t hours);
+    bool isWindowed() const { return recentWindow.enabled(); }
+    long long getLateRecords() const { return recentWindow.late(); }
+    
+    // Top zones over the newest `hours` hours of the window (clamped to its
+    // length; 0 = all of it), e.g. 1, 6 and 24 with setWindow(24)
+    std::vector<ZoneCount> topZonesInWindow(int k, size_t hours = 0) const;
+    
+    // Per-date and day-of-week counters next to the hour histogram (opt-in).
+    // Rows whose PickupTime has no valid "YYYY-MM-DD" date (years 1900-2199)
+    // are counted as usual but not by date. Exact mode only.
+    void setCalendarCounting(bool enabled);
+    bool isCountingCalendar() const { return calendarCounting; }
+    std::vector<WeeklySlotCount> topWeeklySlots(int k = 10) const;
+    std::vector<DailyZoneCount> topDailyZones(int k = 10) const;
+    
+    // topZones/topBusySlots restricted to pickups between two "YYYY-MM-DD"
+    // dates, both inclusive. Answered from per-day counters with prefix sums
+    // over the days that have rows (see DayCounts); needs calendar counting,
+    // otherwise or for invalid dates the result is empty.
+    std::vector<ZoneCount> topZones(int k, const std::string& from, const std::string& to) const;
+    std::vector<SlotCount> topBusySlots(int k, const std::string& from, const std::string& to) const;
+    
+    // Count (pickup, dropoff) pairs from the DropoffZoneID column (opt-in,
+    // exact mode only). Inputs without that column count no routes.
+    void setRouteCounting(bool enabled);
+    bool isCountingRoutes() const { return routeCounting; }
+    std::vector<RouteCount> topRoutes(int k = 10) const;
+    long long countRoute(std::string_view pickupZone, std::string_view dropoffZone) const;
+    
+    // Sum, min, max and count of Distance and Fare per zone and per (zone,
+    // hour) slot (opt-in, exact mode only). Values are parsed in place and
+    // kept as integer thousandths; a row with a missing or malformed value is
+    // still counted as a trip, just not in that value's aggregates.
+    void setValueCounting(bool enabled);
+    bool isCountingValues() const { return valueCounting; }
+    std::vector<ZoneRevenue> topZonesByRevenue(int k = 10) const;
+    std::vector<SlotRevenue> topBusySlotsByRevenue(int k = 10) const;
+    ValueSummary distanceFor(std::string_view zone) const;
+    ValueSummary distanceFor(std::string_view zone, int hour) const;
+    ValueSummary fareFor(std::string_view zone) const;
+    ValueSummary fareFor(std::string_view zone, int hour) const;
+    
+    // Point queries: trips from a zone, and from a zone in one hour (0-23).
+    // O(1) hash lookups; 0 for unknown zones and out-of-range hours.
+    long long countFor(std::string_view zone) const;
+    long long countFor(std::string_view zone, int hour) const;
+    
+    // Combine analyzers built on other workers: counters and record statistics
+    // are summed, and zone IDs are reused where both dictionaries agree.
+    // Shards must count the same way (exact or approximate with the same
+    // capacity and sketch, same distinct-count precision, and the same
+    // calendar, window, route and value counting). An analyzer with no data
+    // yet switches on the modes the shards use that it has off; one it has
+    // set differently is a mismatch, and its other settings (dedup, columns,
+    // follow mode) are left alone.
+    // On a mismatch nothing is merged and false is returned. A shard may be
+    // this analyzer itself; it counts as its state before the merge.
+    bool merge(const TripAnalyzer& other);
+    bool merge(const std::vector<const TripAnalyzer*>& shards);
+    
+    // Binary snapshot of the aggregated state (zones, counters, statistics).
+    // loadSnapshot replaces the current state and leaves it untouched on failure.
+    bool saveSnapshot(const std::string& path) const;
+    bool loadSnapshot(const std::string& path);
+    
+    // Read-only query view for SnapshotView (see snapshot_view.h), with the
+    // first rankedLength topZones/topBusySlots rows precomputed
+    bool saveSnapshotView(const std::string& path, int rankedLength = 1000) const;
     
     // Clear for testing
     void clear();
     
     // Direct count manipulation for testing
     void addZoneCount(const std::string& zone, int count);
-    void addZoneHourCount(const std::string& zone, int hour, int count);
+    void addZoneHourCount(const std::string& zone, int hour, int count); // hour outside 0-23 is ignored
 };
 
 #endif // TRIP_ANALYZER_H
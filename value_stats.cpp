@@ -0,0 +1,66 @@
+#include "value_stats.h"
+#include <utility>
+
+void ValueStats::merge(size_t slot, const ValueStats& other, size_t otherSlot) {
+    if (other.counts[otherSlot] == 0) {
+        return;
+    }
+    counts[slot] += other.counts[otherSlot];
+    sums[slot] += other.sums[otherSlot];
+    if (other.mins[otherSlot] < mins[slot]) {
+        mins[slot] = other.mins[otherSlot];
+    }
+    if (other.maxs[otherSlot] > maxs[slot]) {
+        maxs[slot] = other.maxs[otherSlot];
+    }
+}
+
+void ValueStats::resize(size_t slots) {
+    if (slots <= counts.size()) {
+        return;
+    }
+    counts.resize(slots, 0);
+    sums.resize(slots, 0);
+    mins.resize(slots, LLONG_MAX);
+    maxs.resize(slots, LLONG_MIN);
+}
+
+ValueSummary ValueStats::summary(size_t slot) const {
+    ValueSummary result;
+    if (slot >= counts.size() || counts[slot] == 0) {
+        return result;
+    }
+    result.count = counts[slot];
+    result.sum = static_cast<double>(sums[slot]) / VALUE_SCALE;
+    result.min = static_cast<double>(mins[slot]) / VALUE_SCALE;
+    result.max = static_cast<double>(maxs[slot]) / VALUE_SCALE;
+    return result;
+}
+
+const std::vector<long long>& ValueStats::column(int which) const {
+    switch (which) {
+    case 0:
+        return counts;
+    case 1:
+        return sums;
+    case 2:
+        return mins;
+    default:
+        return maxs;
+    }
+}
+
+void ValueStats::load(std::vector<long long> countColumn, std::vector<long long> sumColumn,
+                      std::vector<long long> minColumn, std::vector<long long> maxColumn) {
+    counts = std::move(countColumn);
+    sums = std::move(sumColumn);
+    mins = std::move(minColumn);
+    maxs = std::move(maxColumn);
+}
+
+void ValueStats::clear() {
+    counts.clear();
+    sums.clear();
+    mins.clear();
+    maxs.clear();
+}
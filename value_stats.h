@@ -0,0 +1,114 @@
+#ifndef VALUE_STATS_H
+#define VALUE_STATS_H
+
+#include <climits>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Trip values (distance, fare) are kept as integer thousandths, so sums do
+// not depend on the order rows are added in and parallel or merged results
+// match a serial run exactly.
+const long long VALUE_SCALE = 1000;
+
+// Parse a plain decimal ("12", "-3.5", "74.90") into thousandths without
+// allocating. Digits past the third decimal are rounded half up. False for
+// anything else: empty text, exponents, stray characters, or more than 15
+// integer digits.
+inline bool parseDecimal(std::string_view text, long long& thousandths) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    long long whole = 0;
+    int digits = 0;
+    while (p != end && static_cast<unsigned>(*p - '0') <= 9) {
+        if (++digits > 15) {
+            return false;
+        }
+        whole = whole * 10 + (*p - '0');
+        p++;
+    }
+
+    long long fraction = 0;
+    int places = 0;
+    bool roundUp = false;
+    if (p != end && *p == '.') {
+        p++;
+        while (p != end && static_cast<unsigned>(*p - '0') <= 9) {
+            if (places < 3) {
+                fraction = fraction * 10 + (*p - '0');
+            } else if (places == 3) {
+                roundUp = *p >= '5';
+            }
+            places++;
+            p++;
+        }
+    }
+    if (p != end || digits + places == 0) {
+        return false;
+    }
+
+    for (int i = places; i < 3; i++) {
+        fraction *= 10;
+    }
+    long long value = whole * VALUE_SCALE + fraction + (roundUp ? 1 : 0);
+    thousandths = negative ? -value : value;
+    return true;
+}
+
+// Summary of one value over a set of trips
+struct ValueSummary {
+    long long count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+
+    double mean() const { return count > 0 ? sum / count : 0.0; }
+};
+
+// Count, sum, min and max of one value per slot (a zone, or zone * 24 + hour),
+// as parallel arrays so a ranking pass reads only the column it ranks by
+class ValueStats {
+private:
+    std::vector<long long> counts;
+    std::vector<long long> sums;
+    std::vector<long long> mins;
+    std::vector<long long> maxs;
+
+public:
+    void add(size_t slot, long long value) {
+        counts[slot]++;
+        sums[slot] += value;
+        if (value < mins[slot]) {
+            mins[slot] = value;
+        }
+        if (value > maxs[slot]) {
+            maxs[slot] = value;
+        }
+    }
+
+    // Fold in another table's slot
+    void merge(size_t slot, const ValueStats& other, size_t otherSlot);
+
+    // Grow to at least `slots` slots (new slots are empty)
+    void resize(size_t slots);
+    size_t size() const { return counts.size(); }
+
+    long long count(size_t slot) const { return counts[slot]; }
+    long long sum(size_t slot) const { return sums[slot]; }
+    ValueSummary summary(size_t slot) const;
+
+    // Raw arrays for snapshots: count, sum, min, max
+    const std::vector<long long>& column(int which) const;
+    void load(std::vector<long long> countColumn, std::vector<long long> sumColumn,
+              std::vector<long long> minColumn, std::vector<long long> maxColumn);
+
+    void clear();
+};
+
+#endif // VALUE_STATS_H
@@ -0,0 +1,82 @@
+#include "zone_dictionary.h"
+#include "hash_util.h"
+
+// Table size is kept a power of two, at most half full
+static const size_t INITIAL_SLOTS = 64;
+
+ZoneDictionary::ZoneDictionary() : slots(INITIAL_SLOTS, Slot{0, 0}) {}
+
+uint32_t ZoneDictionary::intern(std::string_view zone) {
+    uint64_t h = hashBytes(zone);
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = static_cast<size_t>(h) & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.id == 0) {
+            uint32_t id = static_cast<uint32_t>(names.size());
+            names.emplace_back(zone);
+            hashes.push_back(h);
+            slot.id = id + 1;
+            slot.tag = tag;
+
+            if (names.size() * 2 > slots.size()) {
+                rehash(slots.size() * 2);
+            }
+            return id;
+        }
+        if (slot.tag == tag && names[slot.id - 1] == zone) {
+            return slot.id - 1;
+        }
+    }
+}
+
+uint32_t ZoneDictionary::find(std::string_view zone) const {
+    uint64_t h = hashBytes(zone);
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = static_cast<size_t>(h) & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.id == 0) {
+            return NOT_FOUND;
+        }
+        if (slot.tag == tag && names[slot.id - 1] == zone) {
+            return slot.id - 1;
+        }
+    }
+}
+
+void ZoneDictionary::rehash(size_t capacity) {
+    std::vector<Slot> fresh(capacity, Slot{0, 0});
+    size_t mask = capacity - 1;
+
+    // Hashes are kept per ID, so growing never rehashes the strings
+    for (size_t id = 0; id < names.size(); id++) {
+        size_t i = static_cast<size_t>(hashes[id]) & mask;
+        while (fresh[i].id != 0) {
+            i = (i + 1) & mask;
+        }
+        fresh[i].id = static_cast<uint32_t>(id + 1);
+        fresh[i].tag = static_cast<uint32_t>(hashes[id] >> 32);
+    }
+    slots.swap(fresh);
+}
+
+void ZoneDictionary::reserve(size_t count) {
+    names.reserve(count);
+    hashes.reserve(count);
+    size_t capacity = slots.size();
+    while (count * 2 > capacity) {
+        capacity *= 2;
+    }
+    if (capacity != slots.size()) {
+        rehash(capacity);
+    }
+}
+
+void ZoneDictionary::clear() {
+    names.clear();
+    hashes.clear();
+    slots.assign(INITIAL_SLOTS, Slot{0, 0});
+}
@@ -0,0 +1,43 @@
+#ifndef ZONE_DICTIONARY_H
+#define ZONE_DICTIONARY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Maps each distinct zone string to a dense ID (0, 1, 2, ... in first-seen
+// order). Lookups take a string_view, so rows are interned without building
+// a temporary std::string.
+class ZoneDictionary {
+private:
+    struct Slot {
+        uint32_t id;   // ID + 1, 0 = empty
+        uint32_t tag;  // High hash bits, checked before comparing strings
+    };
+
+    std::vector<std::string> names;
+    std::vector<uint64_t> hashes;
+    std::vector<Slot> slots;
+
+    void rehash(size_t capacity);
+
+public:
+    static const uint32_t NOT_FOUND = UINT32_MAX;
+
+    ZoneDictionary();
+
+    // Return the ID for zone, adding it if it is new
+    uint32_t intern(std::string_view zone);
+
+    // Return the ID for zone, or NOT_FOUND
+    uint32_t find(std::string_view zone) const;
+
+    const std::string& name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+    void reserve(size_t count);
+    void clear();
+};
+
+#endif // ZONE_DICTIONARY_H